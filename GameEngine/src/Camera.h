@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../../dep/SDL2-2.30.5/include/SDL.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "SimdKernels.h"
+
+class Player;
+
+// How one camera maps the world onto its part of the screen for one frame. Camera::update() makes
+// a new one each frame and draw code only reads it, so everything in a frame is drawn from the same place.
+// Camera space is the world scaled by magnification and moved by the offset; the viewport shows
+// viewWidth by viewHeight of it, with y going up.
+struct ViewTransform
+{
+    double offsetX;
+    double offsetY;
+    double magnification;
+    double viewWidth;
+    double viewHeight;
+    SDL_Rect viewport; // the part of the window drawn to, in pixels
+
+    // The whole mapping from world to pixels as one affine transform, for transformRects().
+    // The world moves in whole pixels, so the static layer cache's tiles line up with everything else.
+    ScreenTransform screenTransform() const
+    {
+        double pixelsX = viewport.w / viewWidth;
+        double pixelsY = viewport.h / viewHeight;
+        return {
+            magnification * pixelsX,
+            magnification * pixelsY,
+            pixelsX,
+            pixelsY,
+            std::floor(viewport.x + offsetX * pixelsX + 0.5),
+            std::floor(viewport.y + viewport.h - offsetY * pixelsY + 0.5)
+        };
+    }
+
+    // Where a box of the world (position bottom-left) is drawn. The offsets move and resize textures,
+    // they are added after magnification.
+    SDL_Rect screenRect(long long x, long long y, long long sizeX, long long sizeY,
+        long long x_add = 0, long long y_add = 0, long long sizex_add = 0, long long sizey_add = 0) const
+    {
+        PixelRect rect = transformRect(screenTransform(), double(x), double(y), double(sizeX), double(sizeY),
+            double(x_add), double(y_add), double(sizex_add), double(sizey_add));
+        return { rect.x, rect.y, rect.w, rect.h };
+    }
+
+    // The part of the world the viewport shows, widened on every side by margin camera space units
+    void visibleWorld(double margin, long long& minX, long long& minY, long long& maxX, long long& maxY) const
+    {
+        minX = (long long)std::floor((-offsetX - margin) / magnification);
+        minY = (long long)std::floor((-offsetY - margin) / magnification);
+        maxX = (long long)std::ceil((viewWidth - offsetX + margin) / magnification);
+        maxY = (long long)std::ceil((viewHeight - offsetY + margin) / magnification);
+    }
+
+    // Whether a rectangle from screenRect() shows in the viewport
+    bool onScreen(const SDL_Rect& rect) const
+    {
+        return rect.x < viewport.x + viewport.w && rect.y < viewport.y + viewport.h
+            && rect.x + rect.w > viewport.x && rect.y + rect.h > viewport.y;
+    }
+};
+
+// How every camera moves and zooms
+struct CameraSettings
+{
+    double follow_speed; // share of the way to the players covered every 60th of a second
+    double min_magnification; // how far out the camera zooms when the players spread apart
+    double max_magnification; // and how far in when they are close; equal to min_magnification for a fixed zoom
+    double zoom_fit; // the zoom keeps the two players furthest apart within this share of the view
+};
+
+// Keeps a group of players in the middle of its viewport, moving once per frame.
+// One camera covers the whole window; split-screen is one camera per player, each with its own viewport.
+class Camera
+{
+public:
+    // The players to keep in view, every player if empty
+    std::vector<Player*> follow;
+
+    // The part of the window to draw to, in pixels
+    SDL_Rect viewport = { 0, 0, 0, 0 };
+
+    // Moves towards centring (midX, midY) and the zoom that fits players spread apart, seconds after the last update.
+    // unitsPerPixel is how much of the world a pixel covers at magnification 1.
+    void update(const CameraSettings& settings, double midX, double midY, double spread, double seconds, double unitsPerPixel)
+    {
+        double viewWidth = viewport.w * unitsPerPixel;
+        double viewHeight = viewport.h * unitsPerPixel;
+
+        double targetMagnification = settings.max_magnification;
+        if (spread > 0)
+        {
+            targetMagnification = settings.zoom_fit * std::min(viewWidth, viewHeight) / spread;
+        }
+        targetMagnification = std::clamp(targetMagnification, settings.min_magnification, settings.max_magnification);
+
+        // the same share of the distance every 60th of a second, however long the frame took
+        double step = mPlaced ? 1.0 - std::pow(1.0 - settings.follow_speed, seconds * 60.0) : 1.0;
+
+        double magnification = mView.magnification + (targetMagnification - mView.magnification) * step;
+        double targetX = viewWidth / 2 - midX * magnification;
+        double targetY = viewHeight / 2 - midY * magnification;
+
+        ViewTransform view;
+        view.magnification = magnification;
+        view.offsetX = approach(mView.offsetX, targetX, step);
+        view.offsetY = approach(mView.offsetY, targetY, step);
+        view.viewWidth = viewWidth;
+        view.viewHeight = viewHeight;
+        view.viewport = viewport;
+        mView = view;
+        mPlaced = true;
+    }
+
+    // Keeps the last view but draws it to the current viewport, for frames where there is nothing to follow
+    void hold(double unitsPerPixel)
+    {
+        mView.viewWidth = viewport.w * unitsPerPixel;
+        mView.viewHeight = viewport.h * unitsPerPixel;
+        mView.viewport = viewport;
+    }
+
+    const ViewTransform& view() const
+    {
+        return mView;
+    }
+
+private:
+    // Closer by step of the way, the last 200 units in one go so the camera settles instead of creeping
+    static double approach(double from, double to, double step)
+    {
+        double moved = from + (to - from) * step;
+        return std::abs(to - moved) < 200 ? to : moved;
+    }
+
+    ViewTransform mView = { 0, 0, 1.0, 0, 0, { 0, 0, 0, 0 } };
+    bool mPlaced = false; // the first update jumps straight to the players
+};
\ No newline at end of file
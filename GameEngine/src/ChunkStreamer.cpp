@@ -0,0 +1,147 @@
+#include "ChunkStreamer.h"
+
+#include <iostream>
+#include <algorithm>
+
+ChunkStreamer::~ChunkStreamer()
+{
+    stop();
+}
+
+void ChunkStreamer::start(const std::string& directory, DecodeImage decode)
+{
+    stop();
+    mDirectory = directory;
+    mDecode = decode;
+    mStopping = false;
+    mThread = std::thread(&ChunkStreamer::run, this);
+}
+
+void ChunkStreamer::stop()
+{
+    if (!mThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+
+    mRequests.clear();
+    freeImages(mLoaded);
+    mLoaded.clear();
+}
+
+void ChunkStreamer::requestLoad(ChunkCoord chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back({ chunk, false, {}, {} });
+    }
+    mWake.notify_one();
+}
+
+void ChunkStreamer::requestSave(ChunkCoord chunk, std::vector<StaticEntityDesc> records)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back({ chunk, true, std::move(records), {} });
+    }
+    mWake.notify_one();
+}
+
+bool ChunkStreamer::pollLoaded(ChunkCoord& chunk, std::vector<StaticEntityDesc>& records, std::vector<DecodedImage>& images)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mLoaded.empty())
+    {
+        return false;
+    }
+
+    chunk = mLoaded.front().chunk;
+    records.swap(mLoaded.front().records);
+    images.swap(mLoaded.front().images);
+    mLoaded.pop_front();
+    return true;
+}
+
+std::string ChunkStreamer::path(ChunkCoord chunk) const
+{
+    return mDirectory + "/" + chunkFileName(chunk.x, chunk.y);
+}
+
+void ChunkStreamer::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mWake.wait(lock, [this] { return mStopping || !mRequests.empty(); });
+        if (mRequests.empty())
+        {
+            return; // stopping, and everything queued is done
+        }
+
+        Request request = std::move(mRequests.front());
+        mRequests.pop_front();
+
+        // the disk work happens without the lock, so the main thread can keep queueing
+        lock.unlock();
+        if (request.save)
+        {
+            if (!writeLevelFile(path(request.chunk), request.records.data(), request.records.size()))
+            {
+                std::cerr << "Failed to save chunk " << path(request.chunk) << std::endl;
+            }
+        }
+        else
+        {
+            readLevelFile(path(request.chunk), request.records);
+            decodeImages(request);
+        }
+        lock.lock();
+
+        if (!request.save)
+        {
+            mLoaded.push_back(std::move(request));
+        }
+    }
+}
+
+void ChunkStreamer::decodeImages(Request& request)
+{
+    request.images.clear();
+    if (!mDecode)
+    {
+        return;
+    }
+
+    for (const StaticEntityDesc& record : request.records)
+    {
+        if (record.resourceID == 0)
+        {
+            continue;
+        }
+        auto decoded = std::find_if(request.images.begin(), request.images.end(),
+            [&](const DecodedImage& image) { return image.resourceID == record.resourceID; });
+        if (decoded == request.images.end())
+        {
+            request.images.push_back({ record.resourceID, mDecode(record.resourceID) });
+        }
+    }
+}
+
+void ChunkStreamer::freeImages(std::deque<Request>& requests)
+{
+    for (Request& request : requests)
+    {
+        for (DecodedImage& image : request.images)
+        {
+            SDL_FreeSurface(image.surface);
+        }
+        request.images.clear();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../../dep/SDL2-2.30.5/include/SDL.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+#include "LevelFormat.h"
+
+struct ChunkCoord
+{
+    int32_t x;
+    int32_t y;
+};
+
+// An image a chunk's platforms use, decoded on the IO thread
+struct DecodedImage
+{
+    int32_t resourceID;
+    SDL_Surface* surface; // nullptr if it couldn't be decoded
+};
+
+// Reads and writes chunk files on a background thread, so streaming the world never makes a
+// frame wait on the disk. The main thread queues loads and saves and picks finished loads up
+// with pollLoaded(). Loads also decode the images the chunk's platforms use, so all that is
+// left for the main thread is creating the platforms and uploading their textures.
+// Requests are handled in the order they were made, so a chunk that is saved and then loaded
+// again reads back what was saved.
+class ChunkStreamer
+{
+public:
+    // Decodes a platform image into a new surface, on the IO thread
+    typedef std::function<SDL_Surface*(int32_t resourceID)> DecodeImage;
+
+    ~ChunkStreamer();
+
+    // Starts the IO thread, chunk files are read from and written to directory.
+    // Without decode, loads only read the records.
+    void start(const std::string& directory, DecodeImage decode = nullptr);
+
+    // Finishes every queued request, then stops the IO thread. Has to be called before the
+    // engine DLL unloads, joining a thread from a DLL's static destructors can deadlock.
+    void stop();
+
+    bool running() const
+    {
+        return mThread.joinable();
+    }
+
+    void requestLoad(ChunkCoord chunk);
+
+    void requestSave(ChunkCoord chunk, std::vector<StaticEntityDesc> records);
+
+    // Takes one finished load, false if there are none. A chunk with no file loads empty.
+    // images has every resource the records use once; the caller frees the surfaces.
+    bool pollLoaded(ChunkCoord& chunk, std::vector<StaticEntityDesc>& records, std::vector<DecodedImage>& images);
+
+    std::string path(ChunkCoord chunk) const;
+
+private:
+    struct Request
+    {
+        ChunkCoord chunk;
+        bool save;
+        std::vector<StaticEntityDesc> records;
+        std::vector<DecodedImage> images;
+    };
+
+    void run();
+
+    // Decodes each resource the request's records use
+    void decodeImages(Request& request);
+
+    static void freeImages(std::deque<Request>& requests);
+
+    std::string mDirectory;
+    DecodeImage mDecode;
+    std::thread mThread;
+    std::mutex mMutex; // guards everything below
+    std::condition_variable mWake;
+    std::deque<Request> mRequests;
+    std::deque<Request> mLoaded;
+    bool mStopping = false;
+};
\ No newline at end of file
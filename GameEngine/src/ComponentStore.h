@@ -0,0 +1,315 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "SlotMap.h"
+
+class Texture;
+
+// What an object is made of. Objects with exactly the same components share an archetype,
+// and an archetype keeps each of its components in its own contiguous array.
+enum ComponentFlags : uint32_t
+{
+    COMPONENT_POSITION = 1 << 0,
+    COMPONENT_SIZE = 1 << 1,
+    COMPONENT_RENDER = 1 << 2,
+    COMPONENT_COLLISION = 1 << 3, // collisions are on
+    COMPONENT_PLAYER_PHYSICS = 1 << 4,
+    COMPONENT_STATIC = 1 << 5 // tag, no data: never moves (platforms)
+};
+
+typedef uint32_t ComponentMask;
+
+// position is bottom-left
+struct PositionComponent
+{
+    long long x;
+    long long y;
+};
+
+struct SizeComponent
+{
+    unsigned int sizeX;
+    unsigned int sizeY;
+};
+
+struct RenderComponent
+{
+    long long x_texture_offset;
+    long long y_texture_offset;
+    long long sizex_texture_offset;
+    long long sizey_texture_offset;
+    uint8_t Colour[4];
+    Texture* texture;
+    int draw_layer;
+    int draw_depth;
+    uint32_t draw_order; // the order objects were created in, which goes last in the draw order
+};
+
+struct CollisionComponent
+{
+    int proxy; // node in EntityTree for entities, -1 for everything else
+};
+
+// Everything physics() needs about a player apart from its position and size
+struct PlayerPhysicsComponent
+{
+    long long x_before;
+    long long y_before;
+    long long x_previous;
+    long long y_previous;
+
+    double acceleration;
+    double velocity;
+    double velocity_pp_collision;
+    double velocity_max;
+
+    double gravity_acceleration;
+    double verticle_nongravity_acceleration;
+    double verticle_velocity;
+    double verticle_velocity_max;
+
+    int jump_number;
+    int contact_normal_x;
+    int contact_normal_y;
+};
+
+// All the objects with one set of components. Row i of every array belongs to owners[i];
+// arrays for components the archetype doesn't have stay empty.
+template <typename Owner>
+struct Archetype
+{
+    ComponentMask mask = 0;
+    std::vector<Owner> owners;
+    std::vector<SlotHandle> handles;
+
+    std::vector<PositionComponent> positions;
+    std::vector<SizeComponent> sizes;
+    std::vector<RenderComponent> renders;
+    std::vector<CollisionComponent> collisions;
+    std::vector<PlayerPhysicsComponent> players;
+
+    size_t size() const
+    {
+        return owners.size();
+    }
+
+    bool has(ComponentMask components) const
+    {
+        return (mask & components) == components;
+    }
+
+    // Calls visit(member pointer to the array, component flag) for every component array
+    template <typename F>
+    static void forEachColumn(F&& visit)
+    {
+        visit(&Archetype::positions, COMPONENT_POSITION);
+        visit(&Archetype::sizes, COMPONENT_SIZE);
+        visit(&Archetype::renders, COMPONENT_RENDER);
+        visit(&Archetype::collisions, COMPONENT_COLLISION);
+        visit(&Archetype::players, COMPONENT_PLAYER_PHYSICS);
+    }
+};
+
+// Archetype based component storage. Objects are referred to by handle; their row can move when
+// other objects are removed or their components change, so rows are only valid until the next
+// structural change (version() tells you when that happened).
+template <typename Owner>
+class ComponentStore
+{
+public:
+    struct Location
+    {
+        uint32_t archetype;
+        uint32_t row;
+    };
+
+    // Adds an object with the given components, all zeroed. Fill them in through location().
+    SlotHandle create(ComponentMask mask, const Owner& owner)
+    {
+        uint32_t index = findOrAddArchetype(mask);
+        SlotHandle handle = mLocations.insert({ index, uint32_t(mArchetypes[index].size()) });
+        appendRow(mArchetypes[index], owner, handle);
+        ++mVersion;
+        return handle;
+    }
+
+    // Makes room for count more objects with exactly these components
+    void reserve(ComponentMask mask, size_t count)
+    {
+        Archetype<Owner>& archetype = mArchetypes[findOrAddArchetype(mask)];
+        size_t size = archetype.size() + count;
+        archetype.owners.reserve(size);
+        archetype.handles.reserve(size);
+        Archetype<Owner>::forEachColumn([&](auto column, ComponentMask bit)
+            {
+                if (archetype.mask & bit)
+                {
+                    (archetype.*column).reserve(size);
+                }
+            });
+        mLocations.reserve(mLocations.size() + count);
+    }
+
+    // Makes room for count objects in all, whatever their components. reserve() only counts the objects
+    // of one archetype at a time.
+    void reserveHandles(size_t count)
+    {
+        mLocations.reserve(count);
+    }
+
+    void destroy(SlotHandle handle)
+    {
+        Location* location = mLocations.get(handle);
+        if (location == nullptr)
+        {
+            return;
+        }
+        removeRow(location->archetype, location->row);
+        mLocations.remove(handle);
+        ++mVersion;
+    }
+
+    // Moves the object to the archetype for mask. Components it keeps keep their values,
+    // new ones start zeroed.
+    void setComponents(SlotHandle handle, ComponentMask mask)
+    {
+        Location* location = mLocations.get(handle);
+        if (location == nullptr || mArchetypes[location->archetype].mask == mask)
+        {
+            return;
+        }
+
+        uint32_t toIndex = findOrAddArchetype(mask);
+        Archetype<Owner>& from = mArchetypes[location->archetype];
+        Archetype<Owner>& to = mArchetypes[toIndex];
+        uint32_t fromRow = location->row;
+
+        to.owners.push_back(from.owners[fromRow]);
+        to.handles.push_back(handle);
+        Archetype<Owner>::forEachColumn([&](auto column, ComponentMask bit)
+            {
+                if (to.mask & bit)
+                {
+                    auto& toColumn = to.*column;
+                    toColumn.push_back((from.mask & bit) ? (from.*column)[fromRow] : typename std::decay_t<decltype(toColumn)>::value_type{});
+                }
+            });
+
+        removeRow(location->archetype, fromRow);
+        location->archetype = toIndex;
+        location->row = uint32_t(to.size() - 1);
+        ++mVersion;
+    }
+
+    ComponentMask components(SlotHandle handle) const
+    {
+        const Location* location = mLocations.get(handle);
+        return location ? mArchetypes[location->archetype].mask : 0;
+    }
+
+    Location location(SlotHandle handle) const
+    {
+        return *mLocations.get(handle);
+    }
+
+    Archetype<Owner>& archetype(uint32_t index)
+    {
+        return mArchetypes[index];
+    }
+
+    size_t archetypeCount() const
+    {
+        return mArchetypes.size();
+    }
+
+    // Every archetype with all of the required components and none of the excluded ones.
+    // The result is cached, and only looked at again when a new archetype appears.
+    const std::vector<uint32_t>& query(ComponentMask required, ComponentMask excluded = 0)
+    {
+        Query& cached = mQueries[(uint64_t(excluded) << 32) | required];
+        for (; cached.checked < mArchetypes.size(); ++cached.checked)
+        {
+            ComponentMask mask = mArchetypes[cached.checked].mask;
+            if ((mask & required) == required && (mask & excluded) == 0)
+            {
+                cached.archetypes.push_back(uint32_t(cached.checked));
+            }
+        }
+        return cached.archetypes;
+    }
+
+    // Changes whenever an object is added, removed or changes archetype
+    uint32_t version() const
+    {
+        return mVersion;
+    }
+
+private:
+    struct Query
+    {
+        std::vector<uint32_t> archetypes;
+        size_t checked = 0; // archetypes looked at so far
+    };
+
+    uint32_t findOrAddArchetype(ComponentMask mask)
+    {
+        for (uint32_t i = 0; i < mArchetypes.size(); ++i)
+        {
+            if (mArchetypes[i].mask == mask)
+            {
+                return i;
+            }
+        }
+        mArchetypes.push_back(Archetype<Owner>());
+        mArchetypes.back().mask = mask;
+        return uint32_t(mArchetypes.size() - 1);
+    }
+
+    static void appendRow(Archetype<Owner>& archetype, const Owner& owner, SlotHandle handle)
+    {
+        archetype.owners.push_back(owner);
+        archetype.handles.push_back(handle);
+        Archetype<Owner>::forEachColumn([&](auto column, ComponentMask bit)
+            {
+                if (archetype.mask & bit)
+                {
+                    (archetype.*column).emplace_back();
+                }
+            });
+    }
+
+    // Swap the last row into the gap and fix up the moved object's location
+    void removeRow(uint32_t index, uint32_t row)
+    {
+        Archetype<Owner>& archetype = mArchetypes[index];
+        uint32_t last = uint32_t(archetype.size() - 1);
+        if (row != last)
+        {
+            archetype.owners[row] = archetype.owners[last];
+            archetype.handles[row] = archetype.handles[last];
+            mLocations.get(archetype.handles[row])->row = row;
+        }
+        archetype.owners.pop_back();
+        archetype.handles.pop_back();
+
+        Archetype<Owner>::forEachColumn([&](auto column, ComponentMask bit)
+            {
+                if (archetype.mask & bit)
+                {
+                    auto& values = archetype.*column;
+                    values[row] = values[last];
+                    values.pop_back();
+                }
+            });
+    }
+
+    std::vector<Archetype<Owner>> mArchetypes;
+    SlotMap<Location> mLocations;
+    std::unordered_map<uint64_t, Query> mQueries;
+    uint32_t mVersion = 0;
+};
\ No newline at end of file
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Bounding volume hierarchy for objects that move. Leaves store a "fat" box, the object's box grown
+// by a margin, so an object that only moves a little stays inside its leaf and nothing has to change.
+// When it does leave its fat box the leaf is taken out and reinserted, refitting and rebalancing
+// the nodes above it on the way (the same scheme Box2D uses).
+template <typename T>
+class DynamicAABBTree
+{
+public:
+    static const int NULL_NODE = -1;
+
+    explicit DynamicAABBTree(long long margin)
+        : mRoot(NULL_NODE), mFreeList(NULL_NODE), mMargin(margin), mLeafCount(0)
+    {
+    }
+
+    // Adds an object with the given box, returns the proxy id used to move/remove it
+    int insert(T* object, long long minX, long long minY, long long maxX, long long maxY)
+    {
+        int leaf = allocateNode();
+        Node& node = mNodes[leaf];
+        node.minX = minX - mMargin;
+        node.minY = minY - mMargin;
+        node.maxX = maxX + mMargin;
+        node.maxY = maxY + mMargin;
+        node.object = object;
+        node.height = 0;
+        insertLeaf(leaf);
+        ++mLeafCount;
+        return leaf;
+    }
+
+    // Makes room for this many objects in all without allocating, a tree of n leaves has 2n - 1 nodes
+    void reserve(size_t objects)
+    {
+        mNodes.reserve(objects * 2);
+    }
+
+    void remove(int proxy)
+    {
+        removeLeaf(proxy);
+        freeNode(proxy);
+        --mLeafCount;
+    }
+
+    // Call when the object's box changes. Returns true if the tree had to be updated,
+    // false if the box is still inside the proxy's fat box.
+    bool move(int proxy, long long minX, long long minY, long long maxX, long long maxY)
+    {
+        Node& node = mNodes[proxy];
+        if (node.minX <= minX && node.minY <= minY && node.maxX >= maxX && node.maxY >= maxY)
+        {
+            return false;
+        }
+
+        removeLeaf(proxy);
+        Node& moved = mNodes[proxy];
+        moved.minX = minX - mMargin;
+        moved.minY = minY - mMargin;
+        moved.maxX = maxX + mMargin;
+        moved.maxY = maxY + mMargin;
+        insertLeaf(proxy);
+        return true;
+    }
+
+    // Appends every object whose fat box overlaps the given box to out.
+    // Fat boxes are bigger than the objects, so callers still need an exact test.
+    void query(long long minX, long long minY, long long maxX, long long maxY, std::vector<T*>& out) const
+    {
+        if (mRoot == NULL_NODE)
+        {
+            return;
+        }
+
+        mStack.clear();
+        mStack.push_back(mRoot);
+        while (!mStack.empty())
+        {
+            const Node& node = mNodes[mStack.back()];
+            mStack.pop_back();
+
+            if (node.minX > maxX || node.maxX < minX || node.minY > maxY || node.maxY < minY)
+            {
+                continue;
+            }
+
+            if (node.isLeaf())
+            {
+                out.push_back(node.object);
+            }
+            else
+            {
+                mStack.push_back(node.child1);
+                mStack.push_back(node.child2);
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return mLeafCount;
+    }
+
+private:
+    struct Node
+    {
+        long long minX, minY, maxX, maxY;
+        T* object;
+        int parent; // also the next free node while the node is on the free list
+        int child1;
+        int child2;
+        int height; // leaf = 0, free node = -1
+
+        bool isLeaf() const
+        {
+            return child1 == NULL_NODE;
+        }
+    };
+
+    static double perimeter(long long minX, long long minY, long long maxX, long long maxY)
+    {
+        return 2.0 * (double(maxX - minX) + double(maxY - minY));
+    }
+
+    static double perimeter(const Node& node)
+    {
+        return perimeter(node.minX, node.minY, node.maxX, node.maxY);
+    }
+
+    static double combinedPerimeter(const Node& a, const Node& b)
+    {
+        return perimeter(std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY));
+    }
+
+    void fitToChildren(int index)
+    {
+        Node& node = mNodes[index];
+        const Node& a = mNodes[node.child1];
+        const Node& b = mNodes[node.child2];
+        node.minX = std::min(a.minX, b.minX);
+        node.minY = std::min(a.minY, b.minY);
+        node.maxX = std::max(a.maxX, b.maxX);
+        node.maxY = std::max(a.maxY, b.maxY);
+        node.height = 1 + std::max(a.height, b.height);
+    }
+
+    int allocateNode()
+    {
+        int index;
+        if (mFreeList != NULL_NODE)
+        {
+            index = mFreeList;
+            mFreeList = mNodes[index].parent;
+        }
+        else
+        {
+            index = int(mNodes.size());
+            mNodes.push_back(Node());
+        }
+
+        Node& node = mNodes[index];
+        node.object = nullptr;
+        node.parent = NULL_NODE;
+        node.child1 = NULL_NODE;
+        node.child2 = NULL_NODE;
+        node.height = 0;
+        return index;
+    }
+
+    void freeNode(int index)
+    {
+        mNodes[index].parent = mFreeList;
+        mNodes[index].height = -1;
+        mFreeList = index;
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if (mRoot == NULL_NODE)
+        {
+            mRoot = leaf;
+            mNodes[leaf].parent = NULL_NODE;
+            return;
+        }
+
+        // Walk down to the sibling that grows the tree's total perimeter the least
+        int index = mRoot;
+        while (!mNodes[index].isLeaf())
+        {
+            const Node& node = mNodes[index];
+            const Node& leafNode = mNodes[leaf];
+            double area = perimeter(node);
+            double combined = combinedPerimeter(node, leafNode);
+
+            // cost of making a new parent for this node and the leaf
+            double cost = 2.0 * combined;
+            // minimum cost of pushing the leaf further down
+            double inheritanceCost = 2.0 * (combined - area);
+
+            double cost1 = childCost(node.child1, leafNode, inheritanceCost);
+            double cost2 = childCost(node.child2, leafNode, inheritanceCost);
+
+            if (cost < cost1 && cost < cost2)
+            {
+                break;
+            }
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        int sibling = index;
+        int oldParent = mNodes[sibling].parent;
+        int newParent = allocateNode();
+        mNodes[newParent].parent = oldParent;
+        mNodes[newParent].child1 = sibling;
+        mNodes[newParent].child2 = leaf;
+        mNodes[sibling].parent = newParent;
+        mNodes[leaf].parent = newParent;
+        fitToChildren(newParent);
+
+        if (oldParent == NULL_NODE)
+        {
+            mRoot = newParent;
+        }
+        else if (mNodes[oldParent].child1 == sibling)
+        {
+            mNodes[oldParent].child1 = newParent;
+        }
+        else
+        {
+            mNodes[oldParent].child2 = newParent;
+        }
+
+        refitUpwards(mNodes[leaf].parent);
+    }
+
+    double childCost(int child, const Node& leafNode, double inheritanceCost) const
+    {
+        const Node& node = mNodes[child];
+        double combined = combinedPerimeter(node, leafNode);
+        if (node.isLeaf())
+        {
+            return combined + inheritanceCost;
+        }
+        return (combined - perimeter(node)) + inheritanceCost;
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if (leaf == mRoot)
+        {
+            mRoot = NULL_NODE;
+            return;
+        }
+
+        int parent = mNodes[leaf].parent;
+        int grandParent = mNodes[parent].parent;
+        int sibling = mNodes[parent].child1 == leaf ? mNodes[parent].child2 : mNodes[parent].child1;
+
+        // The sibling takes the parent's place
+        if (grandParent == NULL_NODE)
+        {
+            mRoot = sibling;
+            mNodes[sibling].parent = NULL_NODE;
+        }
+        else
+        {
+            if (mNodes[grandParent].child1 == parent)
+            {
+                mNodes[grandParent].child1 = sibling;
+            }
+            else
+            {
+                mNodes[grandParent].child2 = sibling;
+            }
+            mNodes[sibling].parent = grandParent;
+            refitUpwards(grandParent);
+        }
+        freeNode(parent);
+    }
+
+    void refitUpwards(int index)
+    {
+        while (index != NULL_NODE)
+        {
+            index = balance(index);
+            fitToChildren(index);
+            index = mNodes[index].parent;
+        }
+    }
+
+    // If one child of node a is more than one level taller than the other, rotate the taller child up.
+    // Returns the index of the node now at a's position.
+    int balance(int a)
+    {
+        Node& A = mNodes[a];
+        if (A.isLeaf() || A.height < 2)
+        {
+            return a;
+        }
+
+        int b = A.child1;
+        int c = A.child2;
+        int difference = mNodes[c].height - mNodes[b].height;
+
+        if (difference > 1)
+        {
+            return rotateUp(a, c, true);
+        }
+        if (difference < -1)
+        {
+            return rotateUp(a, b, false);
+        }
+        return a;
+    }
+
+    // Rotate child "up" of node a into a's place
+    int rotateUp(int a, int up, bool upIsChild2)
+    {
+        Node& A = mNodes[a];
+        Node& U = mNodes[up];
+        int f = U.child1;
+        int g = U.child2;
+
+        U.child1 = a;
+        U.parent = A.parent;
+        A.parent = up;
+
+        if (U.parent == NULL_NODE)
+        {
+            mRoot = up;
+        }
+        else if (mNodes[U.parent].child1 == a)
+        {
+            mNodes[U.parent].child1 = up;
+        }
+        else
+        {
+            mNodes[U.parent].child2 = up;
+        }
+
+        // the taller grandchild stays under "up", the shorter one moves under a
+        int keep = mNodes[f].height > mNodes[g].height ? f : g;
+        int give = keep == f ? g : f;
+        U.child2 = keep;
+        if (upIsChild2)
+        {
+            A.child2 = give;
+        }
+        else
+        {
+            A.child1 = give;
+        }
+        mNodes[give].parent = a;
+
+        fitToChildren(a);
+        fitToChildren(up);
+        return up;
+    }
+
+    std::vector<Node> mNodes;
+    mutable std::vector<int> mStack;
+    int mRoot;
+    int mFreeList;
+    long long mMargin;
+    size_t mLeafCount;
+};
@@ -0,0 +1,68 @@
+#include "JobThread.h"
+
+#include <utility>
+
+JobThread::~JobThread()
+{
+    stop();
+}
+
+void JobThread::run(std::function<void()> job)
+{
+    wait();
+    if (!mThread.joinable())
+    {
+        mStopping = false;
+        mThread = std::thread(&JobThread::loop, this);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJob = std::move(job);
+        mBusy = true;
+    }
+    mWake.notify_one();
+}
+
+void JobThread::wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return !mBusy; });
+}
+
+void JobThread::stop()
+{
+    if (!mThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+}
+
+void JobThread::loop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mWake.wait(lock, [this] { return mStopping || mBusy; });
+        if (!mBusy)
+        {
+            return;
+        }
+
+        // the job runs without the lock, so wait() can be called while it does
+        std::function<void()> job = std::move(mJob);
+        lock.unlock();
+        job();
+        lock.lock();
+
+        mBusy = false;
+        mDone.notify_all();
+    }
+}
\ No newline at end of file
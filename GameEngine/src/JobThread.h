@@ -0,0 +1,36 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A thread that runs one job at a time for the thread that owns it: run() hands a job over and
+// returns straight away, wait() blocks until the job is done. main_loop() uses it to simulate and
+// record the next frame while it draws and presents the last one.
+class JobThread
+{
+public:
+    ~JobThread();
+
+    // Starts the thread if it isn't running, then runs job on it. Waits for the previous job first.
+    void run(std::function<void()> job);
+
+    // Blocks until the job given to run() has finished
+    void wait();
+
+    // Finishes the job, then stops the thread. Has to be called before the engine DLL unloads,
+    // joining a thread from a DLL's static destructors can deadlock.
+    void stop();
+
+private:
+    void loop();
+
+    std::thread mThread;
+    std::mutex mMutex; // guards everything below
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    std::function<void()> mJob;
+    bool mBusy = false;
+    bool mStopping = false;
+};
\ No newline at end of file
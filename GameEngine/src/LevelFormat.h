@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+// Binary level files (.lvl), made from text levels by levelconv and read by load_level().
+// A LevelHeader, then header.static_entity_count StaticEntityDesc records starting at
+// header.static_entity_offset. Everything is little endian and laid out exactly as in memory,
+// so the loader hands the mapped records straight to create_static_entities().
+
+const uint32_t LEVEL_MAGIC = 0x4C564C47; // "GLVL"
+const uint32_t LEVEL_VERSION = 1;
+
+// Streamed worlds are cut into square chunks this many world units wide, one level file each
+// (chunk_<x>_<y>.lvl), holding the platforms whose bottom-left corner is in the chunk
+const long long LEVEL_CHUNK_SIZE = 96000;
+
+enum StaticEntityDescFlags : uint32_t
+{
+    STATIC_ENTITY_COLLISIONS = 1 // create the platform with its collisions already on
+};
+
+// One platform for create_static_entities(). Every field has a fixed width and there is no
+// padding the compiler decides on, so an array of these can also be stored in a file as is.
+struct StaticEntityDesc
+{
+    int64_t x; // position is bottom-left
+    int64_t y;
+    uint32_t sizeX;
+    uint32_t sizeY;
+    uint8_t colour[4]; // r, g, b, a; used when resourceID is 0
+    int32_t resourceID; // texture in the mapbg DLLs, 0 for a plain colour
+    uint32_t flags; // StaticEntityDescFlags
+    uint32_t reserved; // keep 0
+};
+
+static_assert(sizeof(StaticEntityDesc) == 40, "StaticEntityDesc is a file format, don't change its size");
+
+struct LevelHeader
+{
+    uint32_t magic; // LEVEL_MAGIC
+    uint32_t version; // LEVEL_VERSION
+    uint32_t record_size; // sizeof(StaticEntityDesc) when the file was written
+    uint32_t static_entity_count;
+    uint64_t static_entity_offset; // from the start of the file, a multiple of 8 so the records are aligned
+};
+
+static_assert(sizeof(LevelHeader) == 24, "LevelHeader is a file format, don't change its size");
+
+// The chunk a world position is in, rounding down so negative positions work too
+inline int32_t chunkOf(long long position)
+{
+    long long chunk = position / LEVEL_CHUNK_SIZE;
+    if (position % LEVEL_CHUNK_SIZE < 0)
+    {
+        --chunk;
+    }
+    return int32_t(chunk);
+}
+
+inline std::string chunkFileName(int32_t chunkX, int32_t chunkY)
+{
+    return "chunk_" + std::to_string(chunkX) + "_" + std::to_string(chunkY) + ".lvl";
+}
+
+// Reads a whole level file into records, replacing what was there. False if it can't be read or isn't a valid level.
+// load_level() maps files instead; this is for threads that want their own copy.
+inline bool readLevelFile(const std::string& path, std::vector<StaticEntityDesc>& records)
+{
+    records.clear();
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+
+    unsigned long long size = (unsigned long long)file.tellg();
+    LevelHeader header;
+    if (size < sizeof(header) || !file.seekg(0).read((char*)&header, sizeof(header)))
+    {
+        return false;
+    }
+
+    if (header.magic != LEVEL_MAGIC || header.version != LEVEL_VERSION || header.record_size != sizeof(StaticEntityDesc)
+        || header.static_entity_offset > size || header.static_entity_count > (size - header.static_entity_offset) / sizeof(StaticEntityDesc))
+    {
+        return false;
+    }
+
+    records.resize(header.static_entity_count);
+    file.seekg(header.static_entity_offset);
+    if (!file.read((char*)records.data(), records.size() * sizeof(StaticEntityDesc)))
+    {
+        records.clear();
+        return false;
+    }
+    return true;
+}
+
+// Writes records as a level file, replacing the file if it exists
+inline bool writeLevelFile(const std::string& path, const StaticEntityDesc* records, size_t count)
+{
+    LevelHeader header = {};
+    header.magic = LEVEL_MAGIC;
+    header.version = LEVEL_VERSION;
+    header.record_size = sizeof(StaticEntityDesc);
+    header.static_entity_count = uint32_t(count);
+    header.static_entity_offset = sizeof(LevelHeader);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)records, count * sizeof(StaticEntityDesc));
+    return bool(file);
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size blocks for objects of one type, handed out from chunks that are never freed
+// while the pool lives. Addresses stay stable and freed blocks are reused in LIFO order,
+// so once the pool has grown to the peak object count, allocate() never touches the heap.
+// Used by the class-level operator new / delete of the engine's object types.
+template <typename T, size_t BLOCKS_PER_CHUNK = 256>
+class ObjectPool
+{
+public:
+    void* allocate()
+    {
+        if (mFreeList == nullptr)
+        {
+            addChunk(BLOCKS_PER_CHUNK);
+        }
+
+        Block* block = mFreeList;
+        mFreeList = block->next;
+        ++mLive;
+        return block->storage;
+    }
+
+    void deallocate(void* memory)
+    {
+        if (memory == nullptr)
+        {
+            return;
+        }
+
+        // storage is the first member of the union, so the block starts at the same address
+        Block* block = static_cast<Block*>(memory);
+        block->next = mFreeList;
+        mFreeList = block;
+        --mLive;
+    }
+
+    // Makes sure count objects can be alive at once without allocating another chunk
+    void reserve(size_t count)
+    {
+        if (count > mCapacity)
+        {
+            addChunk(count - mCapacity);
+        }
+    }
+
+    // objects currently allocated
+    size_t size() const
+    {
+        return mLive;
+    }
+
+    // objects that fit before the next chunk is needed
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+private:
+    union Block
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+        Block* next;
+    };
+
+    void addChunk(size_t blocks)
+    {
+        mChunks.push_back(std::make_unique<Block[]>(blocks));
+        Block* chunk = mChunks.back().get();
+
+        // thread the new blocks onto the free list so the lowest address is handed out first
+        for (size_t i = blocks; i-- > 0;)
+        {
+            chunk[i].next = mFreeList;
+            mFreeList = &chunk[i];
+        }
+        mCapacity += blocks;
+    }
+
+    std::vector<std::unique_ptr<Block[]>> mChunks;
+    Block* mFreeList = nullptr;
+    size_t mCapacity = 0;
+    size_t mLive = 0;
+};
\ No newline at end of file
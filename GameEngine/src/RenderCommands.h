@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "Camera.h"
+#include "SpriteBatch.h"
+
+// One camera's part of a frame: the view it was recorded with and the sprites recorded for it
+struct ViewCommands
+{
+    ViewTransform view;
+    SpriteBatch sprites;
+    unsigned long long culled; // objects left out because they were off screen
+};
+
+// The draw commands of one frame: rectangles and textures with their source rects and flips, per camera.
+// Recording one touches no SDL state, so the simulation thread can record a frame while the main
+// thread submits the one before. The views keep their storage from frame to frame.
+class RenderCommandList
+{
+public:
+    // Empties the list for a new frame
+    void clear()
+    {
+        for (size_t i = 0; i < mUsed; ++i)
+        {
+            mViews[i].sprites.clear();
+        }
+        mUsed = 0;
+    }
+
+    // Starts recording for a camera
+    ViewCommands& addView(const ViewTransform& view)
+    {
+        if (mUsed == mViews.size())
+        {
+            mViews.emplace_back();
+        }
+        ViewCommands& commands = mViews[mUsed++];
+        commands.view = view;
+        commands.culled = 0;
+        return commands;
+    }
+
+    size_t size() const
+    {
+        return mUsed;
+    }
+
+    ViewCommands& operator[](size_t index)
+    {
+        return mViews[index];
+    }
+
+private:
+    std::vector<ViewCommands> mViews;
+    size_t mUsed = 0;
+};
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "SimdKernels.h"
+
+// Pick the widest instruction set the compiler is targeting.
+// MSVC x64 always has SSE2; AVX needs /arch:AVX (or /arch:AVX2), which GameEngine.vcxproj builds with.
+#if defined(__AVX__)
+#define SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+
+// The per-tick constants of the integrator for ticks step 60ths of a second long
+struct TickConstants
+{
+    double step;
+    double friction; // speed lost when fast
+    double slowdown; // share of the speed kept when slow
+    double impulseDecay; // share of a jump's push kept
+    double impulseShare; // how much of a jump's push goes into the velocity, so the push adds up to the same at any rate
+};
+
+static TickConstants tickConstants(double step)
+{
+    double decay = std::pow(0.5, step);
+    return { step, 30 * step, decay, decay, (1 - decay) / 0.5 };
+}
+
+// One player, same maths as the vector versions below
+static void integratePlayer(PlayerPhysicsSoA& p, size_t i, const TickConstants& c)
+{
+    // Horizontal Player Movement:
+    double v = p.velocity[i] + p.acceleration[i] * c.step;
+    // How slippery the movement is: lose 30 every 60th of a second when fast, half the speed when slow
+    v = v > 100 ? v - c.friction : (v < -100 ? v + c.friction : v * c.slowdown);
+
+    double vmax = p.velocity_max[i];
+    v = v > vmax ? vmax : (v < -1 * vmax ? -1 * vmax : v);
+
+    p.velocity[i] = v;
+    p.dx[i] = (v + p.velocity_pp_collision[i]) * c.step;
+
+    // Player Gravity:
+    double vv = p.verticle_velocity[i] + (p.gravity_acceleration[i] * c.step + p.verticle_nongravity_acceleration[i] * c.impulseShare);
+
+    double vna = p.verticle_nongravity_acceleration[i] * c.impulseDecay;
+    p.verticle_nongravity_acceleration[i] = vna < 2 ? 0 : vna;
+
+    vv = vv < p.verticle_velocity_max[i] ? p.verticle_velocity_max[i] : vv; // both are negative
+    p.verticle_velocity[i] = vv;
+    p.dy[i] = vv * c.step;
+}
+
+#if defined(SIMD_AVX)
+
+static size_t integratePlayersWide(PlayerPhysicsSoA& p, const TickConstants& c)
+{
+    const __m256d step = _mm256_set1_pd(c.step);
+    const __m256d c100 = _mm256_set1_pd(100);
+    const __m256d cMinus100 = _mm256_set1_pd(-100);
+    const __m256d c30 = _mm256_set1_pd(c.friction);
+    const __m256d slowdown = _mm256_set1_pd(c.slowdown);
+    const __m256d impulseDecay = _mm256_set1_pd(c.impulseDecay);
+    const __m256d impulseShare = _mm256_set1_pd(c.impulseShare);
+    const __m256d two = _mm256_set1_pd(2);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+
+    size_t i = 0;
+    for (; i + 4 <= p.count; i += 4)
+    {
+        __m256d v = _mm256_add_pd(_mm256_loadu_pd(&p.velocity[i]), _mm256_mul_pd(_mm256_loadu_pd(&p.acceleration[i]), step));
+
+        __m256d slowed = _mm256_mul_pd(v, slowdown);
+        slowed = _mm256_blendv_pd(slowed, _mm256_add_pd(v, c30), _mm256_cmp_pd(v, cMinus100, _CMP_LT_OQ));
+        slowed = _mm256_blendv_pd(slowed, _mm256_sub_pd(v, c30), _mm256_cmp_pd(v, c100, _CMP_GT_OQ));
+        v = slowed;
+
+        __m256d vmax = _mm256_loadu_pd(&p.velocity_max[i]);
+        __m256d minusVmax = _mm256_xor_pd(vmax, signBit);
+        __m256d clamped = _mm256_blendv_pd(v, minusVmax, _mm256_cmp_pd(v, minusVmax, _CMP_LT_OQ));
+        clamped = _mm256_blendv_pd(clamped, vmax, _mm256_cmp_pd(v, vmax, _CMP_GT_OQ));
+
+        _mm256_storeu_pd(&p.velocity[i], clamped);
+        _mm256_storeu_pd(&p.dx[i], _mm256_mul_pd(_mm256_add_pd(clamped, _mm256_loadu_pd(&p.velocity_pp_collision[i])), step));
+
+        __m256d vna = _mm256_loadu_pd(&p.verticle_nongravity_acceleration[i]);
+        __m256d vv = _mm256_add_pd(_mm256_loadu_pd(&p.verticle_velocity[i]),
+            _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&p.gravity_acceleration[i]), step), _mm256_mul_pd(vna, impulseShare)));
+
+        vna = _mm256_mul_pd(vna, impulseDecay);
+        vna = _mm256_blendv_pd(vna, zero, _mm256_cmp_pd(vna, two, _CMP_LT_OQ));
+        _mm256_storeu_pd(&p.verticle_nongravity_acceleration[i], vna);
+
+        __m256d vvmax = _mm256_loadu_pd(&p.verticle_velocity_max[i]);
+        vv = _mm256_blendv_pd(vv, vvmax, _mm256_cmp_pd(vv, vvmax, _CMP_LT_OQ));
+        _mm256_storeu_pd(&p.verticle_velocity[i], vv);
+        _mm256_storeu_pd(&p.dy[i], _mm256_mul_pd(vv, step));
+    }
+    return i;
+}
+
+#elif defined(SIMD_SSE2)
+
+// mask ? ifTrue : ifFalse, per lane (SSE2 has no blend instruction)
+static inline __m128d select(__m128d mask, __m128d ifTrue, __m128d ifFalse)
+{
+    return _mm_or_pd(_mm_and_pd(mask, ifTrue), _mm_andnot_pd(mask, ifFalse));
+}
+
+static size_t integratePlayersWide(PlayerPhysicsSoA& p, const TickConstants& c)
+{
+    const __m128d step = _mm_set1_pd(c.step);
+    const __m128d c100 = _mm_set1_pd(100);
+    const __m128d cMinus100 = _mm_set1_pd(-100);
+    const __m128d c30 = _mm_set1_pd(c.friction);
+    const __m128d slowdown = _mm_set1_pd(c.slowdown);
+    const __m128d impulseDecay = _mm_set1_pd(c.impulseDecay);
+    const __m128d impulseShare = _mm_set1_pd(c.impulseShare);
+    const __m128d two = _mm_set1_pd(2);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d signBit = _mm_set1_pd(-0.0);
+
+    size_t i = 0;
+    for (; i + 2 <= p.count; i += 2)
+    {
+        __m128d v = _mm_add_pd(_mm_loadu_pd(&p.velocity[i]), _mm_mul_pd(_mm_loadu_pd(&p.acceleration[i]), step));
+
+        __m128d slowed = _mm_mul_pd(v, slowdown);
+        slowed = select(_mm_cmplt_pd(v, cMinus100), _mm_add_pd(v, c30), slowed);
+        slowed = select(_mm_cmpgt_pd(v, c100), _mm_sub_pd(v, c30), slowed);
+        v = slowed;
+
+        __m128d vmax = _mm_loadu_pd(&p.velocity_max[i]);
+        __m128d minusVmax = _mm_xor_pd(vmax, signBit);
+        __m128d clamped = select(_mm_cmplt_pd(v, minusVmax), minusVmax, v);
+        clamped = select(_mm_cmpgt_pd(v, vmax), vmax, clamped);
+
+        _mm_storeu_pd(&p.velocity[i], clamped);
+        _mm_storeu_pd(&p.dx[i], _mm_mul_pd(_mm_add_pd(clamped, _mm_loadu_pd(&p.velocity_pp_collision[i])), step));
+
+        __m128d vna = _mm_loadu_pd(&p.verticle_nongravity_acceleration[i]);
+        __m128d vv = _mm_add_pd(_mm_loadu_pd(&p.verticle_velocity[i]),
+            _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(&p.gravity_acceleration[i]), step), _mm_mul_pd(vna, impulseShare)));
+
+        vna = _mm_mul_pd(vna, impulseDecay);
+        vna = select(_mm_cmplt_pd(vna, two), zero, vna);
+        _mm_storeu_pd(&p.verticle_nongravity_acceleration[i], vna);
+
+        __m128d vvmax = _mm_loadu_pd(&p.verticle_velocity_max[i]);
+        vv = select(_mm_cmplt_pd(vv, vvmax), vvmax, vv);
+        _mm_storeu_pd(&p.verticle_velocity[i], vv);
+        _mm_storeu_pd(&p.dy[i], _mm_mul_pd(vv, step));
+    }
+    return i;
+}
+
+#else
+
+static size_t integratePlayersWide(PlayerPhysicsSoA& p, const TickConstants& c)
+{
+    return 0;
+}
+
+#endif
+
+void integratePlayers(PlayerPhysicsSoA& players, double step)
+{
+    const TickConstants constants = tickConstants(step);
+    size_t i = integratePlayersWide(players, constants);
+
+    // whatever didn't fill a whole vector
+    for (; i < players.count; ++i)
+    {
+        integratePlayer(players, i, constants);
+    }
+}
+
+uint64_t overlapAABBs(long long minX, long long minY, long long maxX, long long maxY, const PackedAABBs& boxes, size_t first, size_t count)
+{
+    uint64_t mask = 0;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i queryMinX = _mm256_set1_epi64x(minX);
+    const __m256i queryMinY = _mm256_set1_epi64x(minY);
+    const __m256i queryMaxX = _mm256_set1_epi64x(maxX);
+    const __m256i queryMaxY = _mm256_set1_epi64x(maxY);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        size_t b = first + i;
+        __m256i boxMinX = _mm256_loadu_si256((const __m256i*)&boxes.minX[b]);
+        __m256i boxMinY = _mm256_loadu_si256((const __m256i*)&boxes.minY[b]);
+        __m256i boxMaxX = _mm256_loadu_si256((const __m256i*)&boxes.maxX[b]);
+        __m256i boxMaxY = _mm256_loadu_si256((const __m256i*)&boxes.maxY[b]);
+
+        // a lane is apart if any edge is strictly past the opposite edge of the query
+        __m256i apart = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi64(boxMinX, queryMaxX), _mm256_cmpgt_epi64(queryMinX, boxMaxX)),
+            _mm256_or_si256(_mm256_cmpgt_epi64(boxMinY, queryMaxY), _mm256_cmpgt_epi64(queryMinY, boxMaxY)));
+
+        uint64_t lanes = uint64_t(~_mm256_movemask_pd(_mm256_castsi256_pd(apart)) & 0xF);
+        mask |= lanes << i;
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        size_t b = first + i;
+        bool overlaps = boxes.minX[b] <= maxX && boxes.maxX[b] >= minX && boxes.minY[b] <= maxY && boxes.maxY[b] >= minY;
+        mask |= uint64_t(overlaps) << i;
+    }
+
+    return mask;
+}
+
+void overlapAABBs(long long minX, long long minY, long long maxX, long long maxY, const PackedAABBs& boxes, std::vector<uint64_t>& mask)
+{
+    size_t count = boxes.size();
+    mask.resize((count + 63) / 64);
+    for (size_t word = 0; word < mask.size(); ++word)
+    {
+        size_t first = word * 64;
+        mask[word] = overlapAABBs(minX, minY, maxX, maxY, boxes, first, count - first < 64 ? count - first : 64);
+    }
+}
+
+
+#if defined(SIMD_AVX)
+
+static size_t transformRectsWide(const ScreenTransform& t, const PackedDrawRects& r, PixelRect* out)
+{
+    const __m256d scaleX = _mm256_set1_pd(t.scaleX);
+    const __m256d scaleY = _mm256_set1_pd(t.scaleY);
+    const __m256d offsetScaleX = _mm256_set1_pd(t.offsetScaleX);
+    const __m256d offsetScaleY = _mm256_set1_pd(t.offsetScaleY);
+    const __m256d translateX = _mm256_set1_pd(t.translateX);
+    const __m256d translateY = _mm256_set1_pd(t.translateY);
+    const __m256d minPixel = _mm256_set1_pd(min_pixel);
+    const __m256d maxPixel = _mm256_set1_pd(max_pixel);
+
+    size_t i = 0;
+    size_t count = r.size();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(&r.x[i]);
+        __m256d y = _mm256_loadu_pd(&r.y[i]);
+        __m256d w = _mm256_loadu_pd(&r.w[i]);
+        __m256d h = _mm256_loadu_pd(&r.h[i]);
+
+        __m256d left = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, scaleX), _mm256_mul_pd(_mm256_loadu_pd(&r.ox[i]), offsetScaleX)), translateX);
+        __m256d top = _mm256_sub_pd(_mm256_sub_pd(translateY, _mm256_mul_pd(_mm256_add_pd(y, h), scaleY)), _mm256_mul_pd(_mm256_loadu_pd(&r.oy[i]), offsetScaleY));
+        __m256d width = _mm256_add_pd(_mm256_mul_pd(w, scaleX), _mm256_mul_pd(_mm256_loadu_pd(&r.ow[i]), offsetScaleX));
+        __m256d height = _mm256_add_pd(_mm256_mul_pd(h, scaleY), _mm256_mul_pd(_mm256_loadu_pd(&r.oh[i]), offsetScaleY));
+
+        // clamped like toPixel(), then four ints per field, transposed into four x, y, w, h rectangles
+        left = _mm256_min_pd(_mm256_max_pd(left, minPixel), maxPixel);
+        top = _mm256_min_pd(_mm256_max_pd(top, minPixel), maxPixel);
+        width = _mm256_min_pd(_mm256_max_pd(width, minPixel), maxPixel);
+        height = _mm256_min_pd(_mm256_max_pd(height, minPixel), maxPixel);
+        __m128 rect0 = _mm_castsi128_ps(_mm256_cvttpd_epi32(left));
+        __m128 rect1 = _mm_castsi128_ps(_mm256_cvttpd_epi32(top));
+        __m128 rect2 = _mm_castsi128_ps(_mm256_cvttpd_epi32(width));
+        __m128 rect3 = _mm_castsi128_ps(_mm256_cvttpd_epi32(height));
+        _MM_TRANSPOSE4_PS(rect0, rect1, rect2, rect3);
+
+        _mm_storeu_ps((float*)&out[i], rect0);
+        _mm_storeu_ps((float*)&out[i + 1], rect1);
+        _mm_storeu_ps((float*)&out[i + 2], rect2);
+        _mm_storeu_ps((float*)&out[i + 3], rect3);
+    }
+    return i;
+}
+
+#elif defined(SIMD_SSE2)
+
+static size_t transformRectsWide(const ScreenTransform& t, const PackedDrawRects& r, PixelRect* out)
+{
+    const __m128d scaleX = _mm_set1_pd(t.scaleX);
+    const __m128d scaleY = _mm_set1_pd(t.scaleY);
+    const __m128d offsetScaleX = _mm_set1_pd(t.offsetScaleX);
+    const __m128d offsetScaleY = _mm_set1_pd(t.offsetScaleY);
+    const __m128d translateX = _mm_set1_pd(t.translateX);
+    const __m128d translateY = _mm_set1_pd(t.translateY);
+    const __m128d minPixel = _mm_set1_pd(min_pixel);
+    const __m128d maxPixel = _mm_set1_pd(max_pixel);
+
+    size_t i = 0;
+    size_t count = r.size();
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d x = _mm_loadu_pd(&r.x[i]);
+        __m128d y = _mm_loadu_pd(&r.y[i]);
+        __m128d w = _mm_loadu_pd(&r.w[i]);
+        __m128d h = _mm_loadu_pd(&r.h[i]);
+
+        __m128d left = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, scaleX), _mm_mul_pd(_mm_loadu_pd(&r.ox[i]), offsetScaleX)), translateX);
+        __m128d top = _mm_sub_pd(_mm_sub_pd(translateY, _mm_mul_pd(_mm_add_pd(y, h), scaleY)), _mm_mul_pd(_mm_loadu_pd(&r.oy[i]), offsetScaleY));
+        __m128d width = _mm_add_pd(_mm_mul_pd(w, scaleX), _mm_mul_pd(_mm_loadu_pd(&r.ow[i]), offsetScaleX));
+        __m128d height = _mm_add_pd(_mm_mul_pd(h, scaleY), _mm_mul_pd(_mm_loadu_pd(&r.oh[i]), offsetScaleY));
+
+        // clamped like toPixel(), then two ints per field in the low half, interleaved into two x, y, w, h rectangles
+        left = _mm_min_pd(_mm_max_pd(left, minPixel), maxPixel);
+        top = _mm_min_pd(_mm_max_pd(top, minPixel), maxPixel);
+        width = _mm_min_pd(_mm_max_pd(width, minPixel), maxPixel);
+        height = _mm_min_pd(_mm_max_pd(height, minPixel), maxPixel);
+        __m128i xy = _mm_unpacklo_epi32(_mm_cvttpd_epi32(left), _mm_cvttpd_epi32(top));
+        __m128i wh = _mm_unpacklo_epi32(_mm_cvttpd_epi32(width), _mm_cvttpd_epi32(height));
+        _mm_storeu_si128((__m128i*)&out[i], _mm_unpacklo_epi64(xy, wh));
+        _mm_storeu_si128((__m128i*)&out[i + 1], _mm_unpackhi_epi64(xy, wh));
+    }
+    return i;
+}
+
+#else
+
+static size_t transformRectsWide(const ScreenTransform& t, const PackedDrawRects& r, PixelRect* out)
+{
+    return 0;
+}
+
+#endif
+
+void transformRects(const ScreenTransform& transform, const PackedDrawRects& rects, std::vector<PixelRect>& out)
+{
+    out.resize(rects.size());
+    size_t i = transformRectsWide(transform, rects, out.data());
+
+    // whatever didn't fill a whole vector
+    for (; i < rects.size(); ++i)
+    {
+        out[i] = transformRect(transform, rects.x[i], rects.y[i], rects.w[i], rects.h[i], rects.ox[i], rects.oy[i], rects.ow[i], rects.oh[i]);
+    }
+}
\ No newline at end of file
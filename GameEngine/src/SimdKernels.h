@@ -0,0 +1,213 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+
+// The per-tick physics values of every player, one array per field (structure of arrays) so the
+// integrator can work on several players per instruction. physics() fills it from the Player
+// objects, runs integratePlayers() and writes the results back.
+struct PlayerPhysicsSoA
+{
+    std::vector<double> acceleration;
+    std::vector<double> velocity;
+    std::vector<double> velocity_pp_collision;
+    std::vector<double> velocity_max;
+
+    std::vector<double> gravity_acceleration;
+    std::vector<double> verticle_nongravity_acceleration;
+    std::vector<double> verticle_velocity;
+    std::vector<double> verticle_velocity_max;
+
+    // Output: how far each player moves this tick
+    std::vector<double> dx;
+    std::vector<double> dy;
+
+    size_t count = 0;
+
+    void resize(size_t newCount)
+    {
+        count = newCount;
+        acceleration.resize(newCount);
+        velocity.resize(newCount);
+        velocity_pp_collision.resize(newCount);
+        velocity_max.resize(newCount);
+        gravity_acceleration.resize(newCount);
+        verticle_nongravity_acceleration.resize(newCount);
+        verticle_velocity.resize(newCount);
+        verticle_velocity_max.resize(newCount);
+        dx.resize(newCount);
+        dy.resize(newCount);
+    }
+};
+
+// Horizontal friction, speed clamping and gravity for every player in one pass, without branches.
+// Uses AVX when the compiler targets it, SSE2 otherwise, and plain C++ on anything else.
+// Velocities and accelerations are per 60th of a second whatever the tick rate; step is the tick's
+// length in 60ths of a second. With step 1 it gives exactly the same results as the old per-player if/else chain.
+void integratePlayers(PlayerPhysicsSoA& players, double step);
+
+// Boxes stored one array per edge, so a batch of them can be tested against one box at once
+struct PackedAABBs
+{
+    std::vector<long long> minX;
+    std::vector<long long> minY;
+    std::vector<long long> maxX;
+    std::vector<long long> maxY;
+
+    size_t size() const
+    {
+        return minX.size();
+    }
+
+    void clear()
+    {
+        minX.clear();
+        minY.clear();
+        maxX.clear();
+        maxY.clear();
+    }
+
+    void reserve(size_t count)
+    {
+        minX.reserve(count);
+        minY.reserve(count);
+        maxX.reserve(count);
+        maxY.reserve(count);
+    }
+
+    void push_back(long long boxMinX, long long boxMinY, long long boxMaxX, long long boxMaxY)
+    {
+        minX.push_back(boxMinX);
+        minY.push_back(boxMinY);
+        maxX.push_back(boxMaxX);
+        maxY.push_back(boxMaxY);
+    }
+
+    // Removes box i by moving the last box into its place
+    void swapRemove(size_t i)
+    {
+        minX[i] = minX.back();
+        minY[i] = minY.back();
+        maxX[i] = maxX.back();
+        maxY[i] = maxY.back();
+        minX.pop_back();
+        minY.pop_back();
+        maxX.pop_back();
+        maxY.pop_back();
+    }
+};
+
+// Tests boxes [first, first + count) against one query box, count is at most 64.
+// Bit i of the result is set when box first + i overlaps the query (touching edges count).
+// Uses AVX2 (4 boxes per step) when the compiler targets it, plain C++ otherwise.
+uint64_t overlapAABBs(long long minX, long long minY, long long maxX, long long maxY, const PackedAABBs& boxes, size_t first, size_t count);
+
+// Same test over every box. Bit i % 64 of mask[i / 64] is set when box i overlaps;
+// mask is resized to fit.
+void overlapAABBs(long long minX, long long minY, long long maxX, long long maxY, const PackedAABBs& boxes, std::vector<uint64_t>& mask);
+
+
+// How a camera maps world rectangles to pixels, worked out once per frame (see ViewTransform).
+// For a rectangle at x, y (bottom-left) of size w, h with texture offsets ox, oy, ow, oh:
+//   left   = x * scaleX + ox * offsetScaleX + translateX
+//   top    = translateY - (y + h) * scaleY - oy * offsetScaleY   (the world's y goes up, the screen's down)
+//   width  = w * scaleX + ow * offsetScaleX
+//   height = h * scaleY + oh * offsetScaleY
+// each then clamped to [min_pixel, max_pixel] and truncated towards zero to whole pixels.
+struct ScreenTransform
+{
+    double scaleX;
+    double scaleY;
+    double offsetScaleX;
+    double offsetScaleY;
+    double translateX;
+    double translateY;
+};
+
+// Same layout as SDL_Rect, so the results can be handed to SDL as they are
+struct PixelRect
+{
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+// Pixel values are clamped to these before they're narrowed to int: a rectangle far off screen would
+// otherwise be past the int range (undefined for a cast, INT_MIN for the SIMD conversion). Half the
+// range leaves room for callers to add a bias or a position and a size without overflowing.
+const double min_pixel = INT_MIN / 2;
+const double max_pixel = INT_MAX / 2;
+
+// Clamps and truncates one pixel value, the same way the SIMD paths do (max then min, so NaN gives min_pixel)
+inline int toPixel(double value)
+{
+    value = value > min_pixel ? value : min_pixel;
+    value = value < max_pixel ? value : max_pixel;
+    return int(value);
+}
+
+// One rectangle, the same maths transformRects() does for many
+inline PixelRect transformRect(const ScreenTransform& t, double x, double y, double w, double h,
+    double ox = 0, double oy = 0, double ow = 0, double oh = 0)
+{
+    return {
+        toPixel((x * t.scaleX + ox * t.offsetScaleX) + t.translateX),
+        toPixel((t.translateY - (y + h) * t.scaleY) - oy * t.offsetScaleY),
+        toPixel(w * t.scaleX + ow * t.offsetScaleX),
+        toPixel(h * t.scaleY + oh * t.offsetScaleY)
+    };
+}
+
+// The rectangles of a frame's drawables, one array per field, for transformRects()
+struct PackedDrawRects
+{
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> w;
+    std::vector<double> h;
+
+    // texture offsets, 0 for plain colour rectangles
+    std::vector<double> ox;
+    std::vector<double> oy;
+    std::vector<double> ow;
+    std::vector<double> oh;
+
+    size_t size() const
+    {
+        return x.size();
+    }
+
+    // Sized once per frame, then filled with set(), so filling doesn't check capacity eight times a rectangle
+    void resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        w.resize(count);
+        h.resize(count);
+        ox.resize(count);
+        oy.resize(count);
+        ow.resize(count);
+        oh.resize(count);
+    }
+
+    void set(size_t i, double rectX, double rectY, double rectW, double rectH,
+        double offsetX = 0, double offsetY = 0, double offsetW = 0, double offsetH = 0)
+    {
+        x[i] = rectX;
+        y[i] = rectY;
+        w[i] = rectW;
+        h[i] = rectH;
+        ox[i] = offsetX;
+        oy[i] = offsetY;
+        ow[i] = offsetW;
+        oh[i] = offsetH;
+    }
+};
+
+// Transforms every rectangle to pixels, out[i] from rects[i]; out is resized to fit.
+// Uses AVX (4 rectangles per step) when the compiler targets it, SSE2 (2) otherwise, and plain C++ on anything else.
+// Gives exactly the same results as transformRect().
+void transformRects(const ScreenTransform& transform, const PackedDrawRects& rects, std::vector<PixelRect>& out);
\ No newline at end of file
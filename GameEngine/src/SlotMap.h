@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Refers to a value in a SlotMap. The generation changes every time a slot is reused,
+// so a handle to a removed value stays invalid even after its slot is given to something else.
+struct SlotHandle
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Unordered container with O(1) insert, remove and lookup by handle.
+// Values are kept packed in one array, so iterating is the same as iterating a std::vector
+// (and operator[] / size() / begin() / end() work on that array). Removing a value moves the
+// last value into its place, so the order of the values is not kept.
+template <typename T>
+class SlotMap
+{
+public:
+    SlotHandle insert(const T& value)
+    {
+        uint32_t slot;
+        if (mFreeList != UINT32_MAX)
+        {
+            slot = mFreeList;
+            mFreeList = mSlots[slot].dense;
+        }
+        else
+        {
+            slot = uint32_t(mSlots.size());
+            mSlots.push_back(Slot());
+        }
+
+        mSlots[slot].dense = uint32_t(mValues.size());
+        mValues.push_back(value);
+        mDenseToSlot.push_back(slot);
+        return { slot, mSlots[slot].generation };
+    }
+
+    // Returns false if the handle was already removed (or never valid)
+    bool remove(SlotHandle handle)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+
+        Slot& slot = mSlots[handle.index];
+        uint32_t dense = slot.dense;
+        uint32_t last = uint32_t(mValues.size() - 1);
+        if (dense != last)
+        {
+            mValues[dense] = mValues[last];
+            mDenseToSlot[dense] = mDenseToSlot[last];
+            mSlots[mDenseToSlot[dense]].dense = dense;
+        }
+        mValues.pop_back();
+        mDenseToSlot.pop_back();
+
+        ++slot.generation;
+        slot.dense = mFreeList;
+        mFreeList = handle.index;
+        return true;
+    }
+
+    bool contains(SlotHandle handle) const
+    {
+        // removing bumps the generation, so a free slot never matches a handle that was given out
+        return handle.index < mSlots.size() && mSlots[handle.index].generation == handle.generation;
+    }
+
+    // nullptr if the handle is no longer valid
+    T* get(SlotHandle handle)
+    {
+        return contains(handle) ? &mValues[mSlots[handle.index].dense] : nullptr;
+    }
+
+    const T* get(SlotHandle handle) const
+    {
+        return contains(handle) ? &mValues[mSlots[handle.index].dense] : nullptr;
+    }
+
+    void reserve(size_t count)
+    {
+        mValues.reserve(count);
+        mDenseToSlot.reserve(count);
+        mSlots.reserve(count);
+    }
+
+    // The packed values, in no particular order
+    const std::vector<T>& values() const
+    {
+        return mValues;
+    }
+
+    T& operator[](size_t i)
+    {
+        return mValues[i];
+    }
+
+    const T& operator[](size_t i) const
+    {
+        return mValues[i];
+    }
+
+    size_t size() const
+    {
+        return mValues.size();
+    }
+
+    bool empty() const
+    {
+        return mValues.empty();
+    }
+
+    typename std::vector<T>::iterator begin()
+    {
+        return mValues.begin();
+    }
+
+    typename std::vector<T>::iterator end()
+    {
+        return mValues.end();
+    }
+
+    typename std::vector<T>::const_iterator begin() const
+    {
+        return mValues.begin();
+    }
+
+    typename std::vector<T>::const_iterator end() const
+    {
+        return mValues.end();
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t dense = 0; // index into mValues, or the next free slot while the slot is free
+        uint32_t generation = 0;
+    };
+
+    std::vector<T> mValues;
+    std::vector<uint32_t> mDenseToSlot;
+    std::vector<Slot> mSlots;
+    uint32_t mFreeList = UINT32_MAX;
+};
\ No newline at end of file
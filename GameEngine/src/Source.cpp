@@ -16,9 +16,67 @@
 #include <any>
 #include <utility>
 #include <unordered_map>
+#include <bit>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstring>
 
 #include "SourceH.h"
 
+#ifdef GAME_ENGINE_COUNT_ALLOCATIONS
+// Count every allocation the engine makes, so benchmarks can check the hot loops don't allocate.
+// Only the Bench configuration replaces operator new for this, shipping builds allocate as normal.
+static std::atomic<unsigned long long> allocations{ 0 };
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+unsigned long long GAME_ENGINE_API allocation_count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+bool GAME_ENGINE_API allocation_counting()
+{
+    return true;
+}
+#else
+unsigned long long GAME_ENGINE_API allocation_count()
+{
+    return 0;
+}
+
+bool GAME_ENGINE_API allocation_counting()
+{
+    return false;
+}
+#endif
+
+// Fixed-block storage behind new/delete of the three object types, so spawning during a match
+// reuses the blocks of destroyed objects instead of going to the heap. Kept out of SourceH.h so only the engine has them.
+static ObjectPool<Entity> EntityPool;
+static ObjectPool<StaticEntity> StaticEntityPool;
+static ObjectPool<Player> PlayerPool;
+
 double roundToSignificantFigures(double num, int n) 
 {
     if (num == 0.0) return 0.0; // Zero check
@@ -62,29 +120,28 @@ long long squared_distance(Player* p1, Player* p2) {
     return dx * dx + dy * dy;
 }
 
-std::pair<long long, long long> find_midpoint()
+// Middle of the players that haven't fallen off the map, the origin if they all have
+template <typename Players>
+std::pair<long long, long long> find_midpoint(const Players& players)
 {
-    // Ensure there is at least one player
-    if (AllPlayers.empty()) {
-        return { 0, 0 }; // Default to origin if no players
-    }
-
     double sum_x = 0;
     double sum_y = 0;
-    int num_players_inscreen = AllPlayers.size();
+    int num_players_inscreen = 0;
 
     // Calculate the sum of all player coordinates
-    for (const auto& player : AllPlayers) 
+    for (Player* player : players)
     {
         if (player->y_before > -75000)
         {
             sum_x += player->x_before + (player->sizeX / 2);
             sum_y += player->y_before + (player->sizeY / 2);
+            num_players_inscreen += 1;
         }
-        else
-        {
-            num_players_inscreen -= 1;
-        }
+    }
+
+    if (num_players_inscreen == 0)
+    {
+        return { 0, 0 };
     }
 
     // Calculate the mean midpoint
@@ -94,17 +151,22 @@ std::pair<long long, long long> find_midpoint()
     return { mean_mid_x, mean_mid_y };
 }
 
-// Function to find the longest distance between any two players
-double findLongestDistance() 
+std::pair<long long, long long> find_midpoint()
+{
+    return find_midpoint(AllPlayers);
+}
+
+// Function to find the longest distance between any two of the players
+template <typename Players>
+double findLongestDistance(const Players& players)
 {
     double longestDistance = 0.0;
 
     // Iterate through all pairs of players
-    for (size_t i = 0; i < AllPlayers.size(); ++i) {
-        for (size_t j = i + 1; j < AllPlayers.size(); ++j) {
-            // Calculate distance between AllPlayers[i] and AllPlayers[j]
-            long long dx = AllPlayers[j]->x - AllPlayers[i]->x;
-            long long dy = AllPlayers[j]->y - AllPlayers[i]->y;
+    for (auto i = players.begin(); i != players.end(); ++i) {
+        for (auto j = std::next(i); j != players.end(); ++j) {
+            double dx = double((*j)->x - (*i)->x);
+            double dy = double((*j)->y - (*i)->y);
             double distance = std::sqrt(dx * dx + dy * dy);
 
             // Update longestDistance if current distance is greater
@@ -120,69 +182,280 @@ double findLongestDistance()
 void draw_original(bool tex, Texture* texture, ColourT Colour[4], long long x_in, long long y_in, long long sizeX_in, long long sizeY_in, 
     long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add)
 {
-    double sizeX, sizeY;
-    sizeX = double(sizeX_in) * camera_magnification;
-    sizeY = double(sizeY_in) * camera_magnification;
+    // drawn the way the first camera sees it
+    const ViewTransform& view = Cameras[0].view();
+
+    if (!tex)
+    {
+        SDL_SetRenderDrawColor(renderer, Colour[0], Colour[1], Colour[2], Colour[3]);
+        SDL_Rect squareRect = view.screenRect(x_in, y_in, sizeX_in, sizeY_in);
+        SDL_RenderFillRect(renderer, &squareRect);
+    }
+    else if (tex)
+    {
+        SDL_Rect textureRect = view.screenRect(x_in, y_in, sizeX_in, sizeY_in, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
+        texture->render(renderer, textureRect.x, textureRect.y, textureRect.w, textureRect.h);
+    }
+}
 
-    double x, y;
-    x = double(x_in) * camera_magnification;
-    y = double(y_in) * camera_magnification;
+// Copies the fields every object type has into its row of Components
+template <typename T>
+void pullCommonComponents(Archetype<EntityRef>& archetype, uint32_t row, T* object)
+{
+    archetype.positions[row] = { object->x, object->y };
+    archetype.sizes[row] = { object->sizeX, object->sizeY };
+
+    RenderComponent& render = archetype.renders[row];
+    render.x_texture_offset = object->x_texture_offset;
+    render.y_texture_offset = object->y_texture_offset;
+    render.sizex_texture_offset = object->sizex_texture_offset;
+    render.sizey_texture_offset = object->sizey_texture_offset;
+    for (int i = 0; i < 4; ++i)
+    {
+        render.Colour[i] = object->Colour[i];
+    }
+    render.texture = object->texture;
+    render.draw_layer = object->draw_layer;
+    render.draw_depth = object->draw_depth;
+}
 
-    if (!quit) // not in menu
+// Copies an object's public fields into its row of Components
+void pullComponents(Archetype<EntityRef>& archetype, uint32_t row)
+{
+    const EntityRef& owner = archetype.owners[row];
+    if (owner.second == ENTITY)
+    {
+        Entity* entity = std::get<Entity*>(owner.first);
+        pullCommonComponents(archetype, row, entity);
+        if (archetype.mask & COMPONENT_COLLISION)
+        {
+            archetype.collisions[row].proxy = entity->collision_proxy;
+        }
+    }
+    else if (owner.second == STATIC_ENTITY)
+    {
+        pullCommonComponents(archetype, row, std::get<StaticEntity*>(owner.first));
+        if (archetype.mask & COMPONENT_COLLISION)
+        {
+            archetype.collisions[row].proxy = -1;
+        }
+    }
+    else if (owner.second == PLAYER)
     {
-        std::pair<long long, long long> mid = find_midpoint();
+        Player* player = std::get<Player*>(owner.first);
+        pullCommonComponents(archetype, row, player);
+        if (archetype.mask & COMPONENT_COLLISION)
+        {
+            archetype.collisions[row].proxy = -1;
+        }
+
+        PlayerPhysicsComponent& physics = archetype.players[row];
+        physics.x_before = player->x_before;
+        physics.y_before = player->y_before;
+        physics.x_previous = player->x_previous;
+        physics.y_previous = player->y_previous;
+        physics.acceleration = player->acceleration;
+        physics.velocity = player->velocity;
+        physics.velocity_pp_collision = player->velocity_pp_collision;
+        physics.velocity_max = player->velocity_max;
+        physics.gravity_acceleration = player->gravity_acceleration;
+        physics.verticle_nongravity_acceleration = player->verticle_nongravity_acceleration;
+        physics.verticle_velocity = player->verticle_velocity;
+        physics.verticle_velocity_max = player->verticle_velocity_max;
+        physics.jump_number = player->jump_number;
+        physics.contact_normal_x = player->contact_normal_x;
+        physics.contact_normal_y = player->contact_normal_y;
+    }
+}
 
-        // Update target camera position
-        targetCameraX = (long long)((192000 / 2) - mid.first);
-        targetCameraY = (long long)((108000 / 2) - mid.second);
+// Copies every player and entity into Components, before physics runs.
+// Static entities don't move, so they are skipped.
+void pullComponents()
+{
+    for (uint32_t index : Components.query(COMPONENT_POSITION, COMPONENT_STATIC))
+    {
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (uint32_t row = 0; row < archetype.size(); ++row)
+        {
+            pullComponents(archetype, row);
+        }
+    }
+}
 
-        // Smoothly move the camera towards the target position
-        cameraX += (targetCameraX - cameraX) * cameraMoveSpeed;
-        if (targetCameraX - cameraX < 200)
+// Copies what physics changed back into the Player objects
+void pushComponents()
+{
+    for (uint32_t index : Components.query(COMPONENT_POSITION | COMPONENT_PLAYER_PHYSICS))
+    {
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (uint32_t row = 0; row < archetype.size(); ++row)
         {
-            cameraX = targetCameraX;
+            Player* player = std::get<Player*>(archetype.owners[row].first);
+            const PlayerPhysicsComponent& physics = archetype.players[row];
+            player->x = archetype.positions[row].x;
+            player->y = archetype.positions[row].y;
+            player->x_before = physics.x_before;
+            player->y_before = physics.y_before;
+            player->x_previous = physics.x_previous;
+            player->y_previous = physics.y_previous;
+            player->velocity = physics.velocity;
+            player->velocity_pp_collision = physics.velocity_pp_collision;
+            player->verticle_nongravity_acceleration = physics.verticle_nongravity_acceleration;
+            player->verticle_velocity = physics.verticle_velocity;
+            player->jump_number = physics.jump_number;
+            player->contact_normal_x = physics.contact_normal_x;
+            player->contact_normal_y = physics.contact_normal_y;
         }
-        cameraY += (targetCameraY - cameraY) * cameraMoveSpeed;
-        if (targetCameraY - cameraY < 200)
+    }
+}
+
+// Still platforms drawn into tiles for draw_screen(), kept out of SourceH.h so only the engine has one
+static StaticLayerCache static_layer_cache;
+
+// Makes static_layer_cache draw the tiles a platform is drawn on again
+void invalidateStaticLayer(const PositionComponent& position, const SizeComponent& size, const RenderComponent& render)
+{
+    if (render.texture == nullptr)
+    {
+        static_layer_cache.invalidate(double(position.x), double(position.y), double(size.sizeX), double(size.sizeY));
+    }
+    else
+    {
+        static_layer_cache.invalidate(double(position.x), double(position.y), double(size.sizeX), double(size.sizeY),
+            double(render.x_texture_offset), double(render.y_texture_offset), double(render.sizex_texture_offset), double(render.sizey_texture_offset));
+    }
+}
+
+// Puts a platform into StaticEntityDrawGrid at the box its row says it is drawn at, moving it if it was there already
+void indexForDrawing(const Archetype<EntityRef>& archetype, uint32_t row)
+{
+    StaticEntity* platform = std::get<StaticEntity*>(archetype.owners[row].first);
+    const PositionComponent& position = archetype.positions[row];
+    const SizeComponent& size = archetype.sizes[row];
+    const RenderComponent& render = archetype.renders[row];
+
+    StaticEntityDrawGrid.remove(platform);
+    StaticEntityDrawGrid.insert(platform, position.x, position.y, size.sizeX, size.sizeY);
+
+    static_draw_margin = std::max({ static_draw_margin,
+        std::abs(render.x_texture_offset) + std::abs(render.sizex_texture_offset),
+        std::abs(render.y_texture_offset) + std::abs(render.sizey_texture_offset) });
+}
+
+// Gives a newly constructed object its row in Components, plus any extra components.
+// Platforms also go into StaticEntityDrawGrid, unless the caller adds a whole batch of them itself,
+// and the static layer cache tiles under them are drawn again.
+SlotHandle addComponents(const EntityRef& owner, ComponentMask extra = 0, bool index_for_drawing = true)
+{
+    static uint32_t next_draw_order = 0;
+
+    ComponentMask mask = COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_RENDER | extra;
+    if (owner.second == STATIC_ENTITY)
+    {
+        mask |= COMPONENT_STATIC;
+    }
+    else if (owner.second == PLAYER)
+    {
+        mask |= COMPONENT_PLAYER_PHYSICS;
+    }
+
+    SlotHandle handle = Components.create(mask, owner);
+    ComponentRow row = Components.location(handle);
+    Archetype<EntityRef>& archetype = Components.archetype(row.archetype);
+    pullComponents(archetype, row.row);
+    archetype.renders[row.row].draw_order = next_draw_order++;
+    if (owner.second == STATIC_ENTITY)
+    {
+        invalidateStaticLayer(archetype.positions[row.row], archetype.sizes[row.row], archetype.renders[row.row]);
+        if (index_for_drawing)
         {
-            cameraY = targetCameraY;
+            indexForDrawing(archetype, row.row);
         }
     }
+    return handle;
+}
 
-    if (!tex)
+// Reads a platform's fields into its row again and puts it back into StaticEntityDrawGrid. If they were
+// changed it has to be drawn again where it was and where it is now.
+void repullPlatform(Archetype<EntityRef>& archetype, uint32_t row)
+{
+    PositionComponent position = archetype.positions[row];
+    SizeComponent size = archetype.sizes[row];
+    RenderComponent render = archetype.renders[row];
+    pullComponents(archetype, row);
+    const RenderComponent& now = archetype.renders[row];
+    if (std::memcmp(&position, &archetype.positions[row], sizeof(position)) != 0
+        || std::memcmp(&size, &archetype.sizes[row], sizeof(size)) != 0
+        || std::memcmp(render.Colour, now.Colour, sizeof(render.Colour)) != 0 || render.texture != now.texture
+        || render.x_texture_offset != now.x_texture_offset || render.y_texture_offset != now.y_texture_offset
+        || render.sizex_texture_offset != now.sizex_texture_offset || render.sizey_texture_offset != now.sizey_texture_offset
+        || render.draw_layer != now.draw_layer || render.draw_depth != now.draw_depth)
     {
-        SDL_SetRenderDrawColor(renderer, Colour[0], Colour[1], Colour[2], Colour[3]);
-        SDL_Rect squareRect = {
-             ((double(x + cameraX) / double(max_X)) * SCREEN_X),
-             (((double(y + sizeY + cameraY) / double(max_Y)) * SCREEN_Y) - (SCREEN_Y)) * -1,
-             (double(sizeX) / double(max_X)) * SCREEN_X,
-             (double(sizeY) / double(max_Y)) * SCREEN_Y
-        };
-        SDL_RenderFillRect(renderer, &squareRect);
+        invalidateStaticLayer(position, size, render);
+        invalidateStaticLayer(archetype.positions[row], archetype.sizes[row], now);
     }
-    else if (tex)
+    indexForDrawing(archetype, row);
+}
+
+// Adds or removes the collision component, moving the object to another archetype
+void setCollisionComponent(SlotHandle handle, bool on)
+{
+    ComponentMask mask = Components.components(handle);
+    Components.setComponents(handle, on ? (mask | COMPONENT_COLLISION) : (mask & ~COMPONENT_COLLISION));
+
+    ComponentRow row = Components.location(handle);
+    Archetype<EntityRef>& archetype = Components.archetype(row.archetype);
+    if (archetype.mask & COMPONENT_STATIC)
+    {
+        repullPlatform(archetype, row.row);
+    }
+    else
+    {
+        pullComponents(archetype, row.row);
+    }
+}
+
+// Loads the mapbg DLL holding a resource, nullptr if the ID isn't in any of them.
+// The caller owns the returned handle and frees it with FreeLibrary.
+HMODULE loadMapBackgroundDLL(int resourceID)
+{
+    if (resourceID > 100 && resourceID < 151)
+    {
+        return LoadLibrary(L"mapbg.dll");
+    }
+    else if (resourceID > 150 && resourceID < 201)
     {
-        texture->render(
-            renderer,
-             (double(x + x_in_add + cameraX) / double(max_X)) * SCREEN_X,
-             ((((double(y + y_in_add + cameraY) + double(sizeY)) / double(max_Y)) * SCREEN_Y) - SCREEN_Y) * -1,
-             (double(sizeX + sizex_in_add) / double(max_X)) * SCREEN_X,
-             (double(sizeY + sizey_in_add) / double(max_Y)) * SCREEN_Y
-        );
+        return LoadLibrary(L"mapbg2.dll");
     }
+    else if (resourceID > 200 && resourceID < 251)
+    {
+        return LoadLibrary(L"mapbg3.dll");
+    }
+    else if (resourceID > 250 && resourceID < 301)
+    {
+        return LoadLibrary(L"mapbg4.dll");
+    }
+    else if (resourceID > 300 && resourceID < 351)
+    {
+        return LoadLibrary(L"mapbg5.dll");
+    }
+    return nullptr;
 }
 
 void Player::CollisionsOn()
 {
-    PlayerCollisions.push_back(this);
+    if (!PlayerCollisions.contains(collision_handle))
+    {
+        collision_handle = PlayerCollisions.insert(this);
+        setCollisionComponent(component_handle, true);
+    }
 }
 
 void Player::CollisionsOff()
 {
-    auto it = std::find(PlayerCollisions.begin(), PlayerCollisions.end(), this);
-    if (it != PlayerCollisions.end())
+    if (PlayerCollisions.remove(collision_handle))
     {
-        PlayerCollisions.erase(it);  // This removes the element at 'it'
+        setCollisionComponent(component_handle, false);
     }
 }
 
@@ -201,6 +474,7 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     jump_number = 0;
 
+    acceleration = 0;
     gravity_acceleration = -60;
     verticle_nongravity_acceleration = 0;
     verticle_velocity = 0;
@@ -218,12 +492,16 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
     x_before = X_POS;
     y_before = Y_POS;
 
+    x_previous = X_POS;
+    y_previous = Y_POS;
+
     sizeX = SizeX;
     sizeY = SizeY;
 
     EntityType ThisType = PLAYER;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 
     AllPlayers.push_back(this);
 }
@@ -246,6 +524,7 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     jump_number = 0;
 
+    acceleration = 0;
     gravity_acceleration = -60;
     verticle_nongravity_acceleration = 0;
     verticle_velocity = 0;
@@ -263,12 +542,16 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
     x_before = X_POS;
     y_before = Y_POS;
 
+    x_previous = X_POS;
+    y_previous = Y_POS;
+
     sizeX = SizeX;
     sizeY = SizeY;
 
     EntityType ThisType = PLAYER;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 
     AllPlayers.push_back(this);
 }
@@ -293,6 +576,7 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     jump_number = 0;
 
+    acceleration = 0;
     gravity_acceleration = -60;
     verticle_nongravity_acceleration = 0;
     verticle_velocity = 0;
@@ -310,12 +594,16 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
     x_before = X_POS;
     y_before = Y_POS;
 
+    x_previous = X_POS;
+    y_previous = Y_POS;
+
     sizeX = SizeX;
     sizeY = SizeY;
 
     EntityType ThisType = PLAYER;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 
     AllPlayers.push_back(this);
 }
@@ -332,33 +620,13 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     if (mapbg)
     {
-        hModule = new HMODULE;
-        if (resourceID > 100 && resourceID < 151)
-        {
-            *hModule = LoadLibrary(L"mapbg.dll");
-        }
-        else if (resourceID > 150 && resourceID < 201)
-        {
-            *hModule = LoadLibrary(L"mapbg2.dll");
-        }
-        else if (resourceID > 200 && resourceID < 251)
-        {
-            *hModule = LoadLibrary(L"mapbg3.dll");
-        }
-        else if (resourceID > 250 && resourceID < 301)
-        {
-            *hModule = LoadLibrary(L"mapbg4.dll");
-        }
-        else if (resourceID > 300 && resourceID < 351)
-        {
-            *hModule = LoadLibrary(L"mapbg5.dll");
-        }
+        hModule = loadMapBackgroundDLL(resourceID);
 
         if (hModule == NULL)
         {
             std::cerr << "Failed to load DLL!" << std::endl;
         }
-        if (!texture->loadFromResourceDLL(renderer, *hModule, resourceID))
+        if (!texture->loadFromResourceDLL(renderer, hModule, resourceID))
         {
             std::cerr << "Failed to load texture from DLL!" << std::endl;
         }
@@ -375,6 +643,7 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     jump_number = 0;
 
+    acceleration = 0;
     gravity_acceleration = -60;
     verticle_nongravity_acceleration = 0;
     verticle_velocity = 0;
@@ -392,12 +661,16 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
     x_before = X_POS;
     y_before = Y_POS;
 
+    x_previous = X_POS;
+    y_previous = Y_POS;
+
     sizeX = SizeX;
     sizeY = SizeY;
 
     EntityType ThisType = PLAYER;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 
     AllPlayers.push_back(this);
 }
@@ -417,6 +690,7 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     jump_number = 0;
 
+    acceleration = 0;
     gravity_acceleration = -60;
     verticle_nongravity_acceleration = 0;
     verticle_velocity = 0;
@@ -431,22 +705,30 @@ Player::Player(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
     x = X_POS;
     y = Y_POS;
 
+    x_before = X_POS;
+    y_before = Y_POS;
+
+    x_previous = X_POS;
+    y_previous = Y_POS;
+
     sizeX = SizeX;
     sizeY = SizeY;
 
-    EntityType ThisType = ENTITY;
+    EntityType ThisType = PLAYER;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 
     AllPlayers.push_back(this);
 }
 
 Player::~Player()
 {
+    CollisionsOff();
+
     if (hModule != nullptr)
     {
-        FreeLibrary(*hModule);
-        delete hModule;
+        FreeLibrary(hModule);
     }
 
     if (texture != nullptr)
@@ -454,31 +736,50 @@ Player::~Player()
         delete texture;
     }
 
-    EntityType ThisType = PLAYER;
-    std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    auto it = std::find(AllEntities.begin(), AllEntities.end(), pushback);
+    AllEntities.remove(entity_handle);
+    Components.destroy(component_handle);
+    AllPlayers.erase(std::find(AllPlayers.begin(), AllPlayers.end(), this));
+}
 
-    // If the element was found, remove it
-    if (it != AllEntities.end()) {
-        AllEntities.erase(it);
+void* Player::operator new(size_t size)
+{
+    // a class derived from Player doesn't fit the pool's blocks
+    if (size != sizeof(Player))
+    {
+        return ::operator new(size);
     }
+    return PlayerPool.allocate();
+}
 
-    auto it2 = std::find(AllPlayers.begin(), AllPlayers.end(), this);
-
-    // If the element was found, remove it
-    if (it2 != AllPlayers.end()) {
-        AllPlayers.erase(it2);
+void Player::operator delete(void* memory, size_t size)
+{
+    // sized like operator new was, so a derived object goes back to the heap it came from
+    if (size != sizeof(Player))
+    {
+        ::operator delete(memory);
+        return;
     }
+    PlayerPool.deallocate(memory);
+}
+
+long long Player::render_x() const
+{
+    return x_previous + (long long)((x - x_previous) * render_alpha);
+}
+
+long long Player::render_y() const
+{
+    return y_previous + (long long)((y - y_previous) * render_alpha);
 }
 
 void Player::draw_tex(long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add)
 {
-    draw_original(true, texture, Colour, x, y, sizeX, sizeY, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
+    draw_original(true, texture, Colour, render_x(), render_y(), sizeX, sizeY, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
 }
 
 void Player::draw(long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add)
 {
-    draw_original(false, nullptr, Colour, x, y, sizeX, sizeY, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
+    draw_original(false, nullptr, Colour, render_x(), render_y(), sizeX, sizeY, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
 }
 
 #ifdef min
@@ -489,266 +790,661 @@ void Player::draw(long long x_in_add, long long y_in_add, long long sizex_in_add
 #undef max
 #endif
 
-void physics()
+PositionComponent& positionOf(ComponentRow row)
 {
-    for (int i1 = 0; i1 < PlayerCollisions.size(); ++i1) {
-        bool inCollision = false; // Flag to check if the current player is in collision
-
-        for (int i2 = 0; i2 < PlayerCollisions.size(); ++i2) {
-            if (i1 != i2) {
-                // Check for collisions in the x direction only
-                if (PlayerCollisions[i1]->x < PlayerCollisions[i2]->x + PlayerCollisions[i2]->sizeX &&
-                    PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX > PlayerCollisions[i2]->x &&
-                    PlayerCollisions[i1]->y < PlayerCollisions[i2]->y + PlayerCollisions[i2]->sizeY &&
-                    PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > PlayerCollisions[i2]->y) {
-
-                    // Players are colliding horizontally
-                    inCollision = true;
-
-                    // Calculate the overlap in the x direction
-                    double overlapX = std::min(PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX, PlayerCollisions[i2]->x + PlayerCollisions[i2]->sizeX) - std::max(PlayerCollisions[i1]->x, PlayerCollisions[i2]->x);
-
-                    // Apply a gradual separation force
-                    double separationForce = overlapX * 0.5; // Gradual separation force
-                    double separationSpeed = 0.1; // Adjust the speed of separation
+    return Components.archetype(row.archetype).positions[row.row];
+}
 
-                    if (PlayerCollisions[i1]->x < PlayerCollisions[i2]->x) {
-                        // Player i1 is on the left side of Player i2
-                        PlayerCollisions[i1]->x -= separationForce * separationSpeed;
-                        PlayerCollisions[i2]->x += separationForce * separationSpeed;
-                    }
-                    else {
-                        // Player i1 is on the right side of Player i2
-                        PlayerCollisions[i1]->x += separationForce * separationSpeed;
-                        PlayerCollisions[i2]->x -= separationForce * separationSpeed;
-                    }
+const SizeComponent& sizeOf(ComponentRow row)
+{
+    return Components.archetype(row.archetype).sizes[row.row];
+}
 
-                    // Apply a horizontal velocity response to each player
-                    double relativeVelocityX = PlayerCollisions[i1]->velocity - PlayerCollisions[i2]->velocity;
-                    double collisionForceX = relativeVelocityX * 0.05; // Simple collision force
+PlayerPhysicsComponent& playerOf(ComponentRow row)
+{
+    return Components.archetype(row.archetype).players[row.row];
+}
 
-                    PlayerCollisions[i1]->velocity -= collisionForceX;
-                    PlayerCollisions[i2]->velocity += collisionForceX;
-                }
+// Keeps PlayerSweepOrder sorted by x. Players move a little each tick, so last tick's order is
+// almost sorted already and insertion sort only does a few swaps.
+void sortPlayerSweepOrder()
+{
+    // Rows move when objects are added, removed or change archetype, so collect them again then
+    static uint32_t version = UINT32_MAX;
+    if (version != Components.version())
+    {
+        PlayerSweepOrder.clear();
+        for (uint32_t index : Components.query(COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_PLAYER_PHYSICS | COMPONENT_COLLISION))
+        {
+            for (uint32_t row = 0; row < Components.archetype(index).size(); ++row)
+            {
+                PlayerSweepOrder.push_back({ index, row });
             }
         }
+        std::sort(PlayerSweepOrder.begin(), PlayerSweepOrder.end(), [](ComponentRow a, ComponentRow b)
+            {
+                return positionOf(a).x < positionOf(b).x;
+            });
+        version = Components.version();
+        return;
+    }
 
-        // Apply deceleration if not in collision
-        if (!inCollision) {
-            PlayerCollisions[i1]->velocity_pp_collision *= 0.9; // Rapidly reduce velocity
-            if (abs(PlayerCollisions[i1]->velocity_pp_collision) < 0.1) {
-                PlayerCollisions[i1]->velocity_pp_collision = 0;
-            }
+    for (size_t i = 1; i < PlayerSweepOrder.size(); ++i)
+    {
+        ComponentRow player = PlayerSweepOrder[i];
+        long long x = positionOf(player).x;
+        size_t j = i;
+        while (j > 0 && positionOf(PlayerSweepOrder[j - 1]).x > x)
+        {
+            PlayerSweepOrder[j] = PlayerSweepOrder[j - 1];
+            --j;
         }
+        PlayerSweepOrder[j] = player;
     }
+}
 
-    for (int i1 = 0; i1 < AllPlayers.size(); ++i1)
-    {
+// Pushes two overlapping players apart
+void separatePlayers(ComponentRow player1, ComponentRow player2)
+{
+    PositionComponent& p1 = positionOf(player1);
+    PositionComponent& p2 = positionOf(player2);
+    const SizeComponent& s1 = sizeOf(player1);
+    const SizeComponent& s2 = sizeOf(player2);
+
+    // Calculate the overlap in the x direction
+    double overlapX = std::min(p1.x + s1.sizeX, p2.x + s2.sizeX) - std::max(p1.x, p2.x);
+
+    // Apply a gradual separation force
+    double separationForce = overlapX * 0.5; // Gradual separation force
+    double separationSpeed = 0.1; // Adjust the speed of separation
+
+    if (p1.x < p2.x) {
+        // Player p1 is on the left side of Player p2
+        p1.x -= separationForce * separationSpeed;
+        p2.x += separationForce * separationSpeed;
+    }
+    else {
+        // Player p1 is on the right side of Player p2
+        p1.x += separationForce * separationSpeed;
+        p2.x -= separationForce * separationSpeed;
+    }
 
-        // Horizontal Player Movement:
+    // Apply a horizontal velocity response to each player
+    PlayerPhysicsComponent& v1 = playerOf(player1);
+    PlayerPhysicsComponent& v2 = playerOf(player2);
+    double relativeVelocityX = v1.velocity - v2.velocity;
+    double collisionForceX = relativeVelocityX * 0.05; // Simple collision force
 
-        AllPlayers[i1]->velocity += AllPlayers[i1]->acceleration;
-        if (AllPlayers[i1]->velocity > 100)
-        {
-            AllPlayers[i1]->velocity -= 30; // How slippery the movement is
-        }
-        else if (AllPlayers[i1]->velocity > 0)
+    v1.velocity -= collisionForceX;
+    v2.velocity += collisionForceX;
+}
+
+// Runs one tick over the rows in Components. The Player/Entity objects aren't touched,
+// pullComponents() and pushComponents() copy to and from them around a batch of ticks.
+void physics()
+{
+    ++physics_stats.ticks;
+
+    const std::vector<uint32_t>& player_archetypes = Components.query(COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_PLAYER_PHYSICS);
+
+    for (uint32_t index : player_archetypes)
+    {
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (size_t row = 0; row < archetype.size(); ++row)
         {
-            AllPlayers[i1]->velocity -= AllPlayers[i1]->velocity / 2;
+            archetype.players[row].x_previous = archetype.positions[row].x;
+            archetype.players[row].y_previous = archetype.positions[row].y;
         }
-        else if (AllPlayers[i1]->velocity < -100)
+    }
+
+    // Player-Player Collision
+    sortPlayerSweepOrder();
+
+    // The players' boxes in sweep order, packed so the sweep reads one small array
+    static PackedAABBs sweep_boxes;
+    sweep_boxes.clear();
+    for (ComponentRow player : PlayerSweepOrder)
+    {
+        const PositionComponent& position = positionOf(player);
+        const SizeComponent& size = sizeOf(player);
+        sweep_boxes.push_back(position.x, position.y, position.x + size.sizeX, position.y + size.sizeY);
+    }
+
+    // Sweep along x: PlayerSweepOrder is sorted by x, so for each player only the players after it
+    // that start before its right edge can overlap it. Each pair is found exactly once.
+    static std::vector<std::pair<size_t, size_t>> player_pairs;
+    player_pairs.clear();
+    for (size_t i1 = 0; i1 < sweep_boxes.size(); ++i1)
+    {
+        for (size_t i2 = i1 + 1; i2 < sweep_boxes.size() && sweep_boxes.minX[i2] < sweep_boxes.maxX[i1]; ++i2)
         {
-            AllPlayers[i1]->velocity += 30; // How slippery the movement is
+            ++physics_stats.player_pairs_tested;
+            if (sweep_boxes.minY[i1] < sweep_boxes.maxY[i2] && sweep_boxes.maxY[i1] > sweep_boxes.minY[i2])
+            {
+                player_pairs.push_back({ i1, i2 });
+            }
         }
-        else if (AllPlayers[i1]->velocity < 0)
+    }
+
+    static std::vector<char> inCollision; // whether each player in PlayerSweepOrder is in a collision
+    inCollision.assign(PlayerSweepOrder.size(), false);
+    for (auto& pair : player_pairs)
+    {
+        const PositionComponent& p1 = positionOf(PlayerSweepOrder[pair.first]);
+        const PositionComponent& p2 = positionOf(PlayerSweepOrder[pair.second]);
+        const SizeComponent& s1 = sizeOf(PlayerSweepOrder[pair.first]);
+        const SizeComponent& s2 = sizeOf(PlayerSweepOrder[pair.second]);
+
+        // an earlier pair may already have pushed these two apart
+        if (p1.x < p2.x + s2.sizeX && p1.x + s1.sizeX > p2.x &&
+            p1.y < p2.y + s2.sizeY && p1.y + s1.sizeY > p2.y)
         {
-            AllPlayers[i1]->velocity -= AllPlayers[i1]->velocity / 2;
+            inCollision[pair.first] = true;
+            inCollision[pair.second] = true;
+            separatePlayers(PlayerSweepOrder[pair.first], PlayerSweepOrder[pair.second]);
         }
-        else if (AllPlayers[i1]->velocity > -2 && AllPlayers[i1]->velocity < 2)
+    }
+
+    // Apply deceleration if not in collision
+    for (size_t i1 = 0; i1 < PlayerSweepOrder.size(); ++i1)
+    {
+        if (!inCollision[i1])
         {
-            AllPlayers[i1]->velocity = 0;
+            PlayerPhysicsComponent& player = playerOf(PlayerSweepOrder[i1]);
+            player.velocity_pp_collision *= std::pow(0.9, tick_step()); // Rapidly reduce velocity
+            if (abs(player.velocity_pp_collision) < 0.1)
+            {
+                player.velocity_pp_collision = 0;
+            }
         }
+    }
+
+    // Integrate every player at once: copy the hot values into PlayerPhysics, run the vector kernel
+    // over the arrays and copy the results back
+    size_t player_count = 0;
+    for (uint32_t index : player_archetypes)
+    {
+        player_count += Components.archetype(index).size();
+    }
 
-        if (AllPlayers[i1]->velocity > AllPlayers[i1]->velocity_max)
+    PlayerPhysics.resize(player_count);
+    size_t i1 = 0;
+    for (uint32_t index : player_archetypes)
+    {
+        const Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (size_t row = 0; row < archetype.size(); ++row, ++i1)
         {
-            AllPlayers[i1]->velocity = AllPlayers[i1]->velocity_max;
+            const PlayerPhysicsComponent& player = archetype.players[row];
+            PlayerPhysics.acceleration[i1] = player.acceleration;
+            PlayerPhysics.velocity[i1] = player.velocity;
+            PlayerPhysics.velocity_pp_collision[i1] = player.velocity_pp_collision;
+            PlayerPhysics.velocity_max[i1] = player.velocity_max;
+            PlayerPhysics.gravity_acceleration[i1] = player.gravity_acceleration;
+            PlayerPhysics.verticle_nongravity_acceleration[i1] = player.verticle_nongravity_acceleration;
+            PlayerPhysics.verticle_velocity[i1] = player.verticle_velocity;
+            PlayerPhysics.verticle_velocity_max[i1] = player.verticle_velocity_max;
         }
-        else if (AllPlayers[i1]->velocity < -1 * AllPlayers[i1]->velocity_max)
+    }
+
+    integratePlayers(PlayerPhysics, tick_step());
+
+    i1 = 0;
+    for (uint32_t index : player_archetypes)
+    {
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (size_t row = 0; row < archetype.size(); ++row, ++i1)
         {
-            AllPlayers[i1]->velocity = -1 * AllPlayers[i1]->velocity_max;
+            PlayerPhysicsComponent& player = archetype.players[row];
+            player.velocity = PlayerPhysics.velocity[i1];
+            player.verticle_nongravity_acceleration = PlayerPhysics.verticle_nongravity_acceleration[i1];
+            player.verticle_velocity = PlayerPhysics.verticle_velocity[i1];
+            archetype.positions[row].x += PlayerPhysics.dx[i1];
+            archetype.positions[row].y += PlayerPhysics.dy[i1];
         }
-        AllPlayers[i1]->x += AllPlayers[i1]->velocity + AllPlayers[i1]->velocity_pp_collision;
+    }
 
-        // Player Gravity:
 
-        AllPlayers[i1]->verticle_velocity += AllPlayers[i1]->gravity_acceleration + AllPlayers[i1]->verticle_nongravity_acceleration;
-        AllPlayers[i1]->verticle_nongravity_acceleration /= 2;
-        if (AllPlayers[i1]->verticle_nongravity_acceleration < 2)
+    // Player-Platform Collision
+    if (broadphase_mode == BROADPHASE_BVH && StaticEntityBVH.dirty())
+    {
+        StaticEntityBVH.build(StaticEntityCollisions.values());
+    }
+
+    // Entities may have been moved since last tick, so refit their nodes first.
+    // Most of them are still inside their fattened box and cost nothing.
+    for (uint32_t index : Components.query(COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_COLLISION, COMPONENT_STATIC | COMPONENT_PLAYER_PHYSICS))
+    {
+        const Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (size_t row = 0; row < archetype.size(); ++row)
         {
-            AllPlayers[i1]->verticle_nongravity_acceleration = 0;
+            const PositionComponent& position = archetype.positions[row];
+            EntityTree.move(archetype.collisions[row].proxy, position.x, position.y, position.x + archetype.sizes[row].sizeX, position.y + archetype.sizes[row].sizeY);
         }
-        if (AllPlayers[i1]->verticle_velocity < AllPlayers[i1]->verticle_velocity_max) // both are negative
+    }
+
+    if (broadphase_mode == BROADPHASE_BRUTE_FORCE && StaticEntityBoundsDirty)
+    {
+        StaticEntityBounds.clear();
+        StaticEntityBounds.reserve(StaticEntityCollisions.size());
+        for (StaticEntity* platform : StaticEntityCollisions)
         {
-            AllPlayers[i1]->verticle_velocity = AllPlayers[i1]->verticle_velocity_max;
+            StaticEntityBounds.push_back(platform->x, platform->y, platform->x + platform->sizeX, platform->y + platform->sizeY);
         }
-        AllPlayers[i1]->y += AllPlayers[i1]->verticle_velocity;
+        StaticEntityBoundsDirty = false;
     }
 
-
-    // Player-Platform Collision
-    for (int i1 = 0; i1 < PlayerCollisions.size(); ++i1)
+    static std::vector<StaticEntity*> platform_candidates;
+    static std::vector<Entity*> entity_candidates;
+    static std::vector<uint64_t> platform_mask;
+    static PackedAABBs obstacles; // boxes of everything the current player might hit
+    for (uint32_t index : Components.query(COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_PLAYER_PHYSICS | COMPONENT_COLLISION))
     {
-        for (int i2 = 0; i2 < StaticEntityCollisions.size(); ++i2)
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (size_t row = 0; row < archetype.size(); ++row)
         {
-
-            if (PlayerCollisions[i1]->y < StaticEntityCollisions[i2]->y + StaticEntityCollisions[i2]->sizeY && // top of platform collision
-                (PlayerCollisions[i1]->y_before > StaticEntityCollisions[i2]->y + StaticEntityCollisions[i2]->sizeY) &&
-                (PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX >= StaticEntityCollisions[i2]->x && PlayerCollisions[i1]->x <= StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX))
+            PositionComponent& position = archetype.positions[row];
+            const SizeComponent& size = archetype.sizes[row];
+            PlayerPhysicsComponent& player = archetype.players[row];
+
+            // Everything the player passed through since last tick, so fast movement still hits
+            long long minX = std::min(position.x, player.x_before);
+            long long minY = std::min(position.y, player.y_before);
+            long long maxX = std::max(position.x, player.x_before) + size.sizeX;
+            long long maxY = std::max(position.y, player.y_before) + size.sizeY;
+
+            obstacles.clear();
+            if (broadphase_mode == BROADPHASE_GRID || broadphase_mode == BROADPHASE_BVH)
             {
-                PlayerCollisions[i1]->jump_number = 0; // player touches ground so can restore jumps
-                PlayerCollisions[i1]->y = StaticEntityCollisions[i2]->y + StaticEntityCollisions[i2]->sizeY;
-                if (PlayerCollisions[i1]->verticle_velocity < 0)
+                platform_candidates.clear();
+                if (broadphase_mode == BROADPHASE_GRID)
                 {
-                    PlayerCollisions[i1]->verticle_velocity = 0;
+                    StaticEntityGrid.query(minX, minY, maxX, maxY, platform_candidates);
                 }
-            }
-            else if ((PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX >= StaticEntityCollisions[i2]->x && PlayerCollisions[i1]->x <= StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX) &&
-                PlayerCollisions[i1]->y_before == StaticEntityCollisions[i2]->y + StaticEntityCollisions[i2]->sizeY &&
-                PlayerCollisions[i1]->y < StaticEntityCollisions[i2]->y + StaticEntityCollisions[i2]->sizeY)
-            {
-                PlayerCollisions[i1]->jump_number = 0; // player touches ground so can restore jumps
-                if (PlayerCollisions[i1]->verticle_velocity < 0)
+                else
                 {
-                    PlayerCollisions[i1]->verticle_velocity = 0;
+                    StaticEntityBVH.query(minX, minY, maxX, maxY, platform_candidates);
                 }
-                PlayerCollisions[i1]->y = PlayerCollisions[i1]->y_before;
-            }
-            else if (PlayerCollisions[i1]->x < StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX && // right of platform collision
-                PlayerCollisions[i1]->x_before > StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX &&
-                PlayerCollisions[i1]->y < StaticEntityCollisions[i2]->y + (StaticEntityCollisions[i2]->sizeY) &&
-                (PlayerCollisions[i1]->y > StaticEntityCollisions[i2]->y || PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > StaticEntityCollisions[i2]->y) &&
-                PlayerCollisions[i1]->x > StaticEntityCollisions[i2]->x)
-            {
-                PlayerCollisions[i1]->x = StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX;
-                if (PlayerCollisions[i1]->velocity < 0)
+
+                for (StaticEntity* platform : platform_candidates)
                 {
-                    PlayerCollisions[i1]->velocity = 0;
+                    obstacles.push_back(platform->x, platform->y, platform->x + platform->sizeX, platform->y + platform->sizeY);
                 }
             }
-            else if (PlayerCollisions[i1]->x < StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX &&
-                PlayerCollisions[i1]->x_before == StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX &&
-                PlayerCollisions[i1]->y < StaticEntityCollisions[i2]->y + (StaticEntityCollisions[i2]->sizeY) &&
-                (PlayerCollisions[i1]->y > StaticEntityCollisions[i2]->y || PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > StaticEntityCollisions[i2]->y) &&
-                PlayerCollisions[i1]->x > StaticEntityCollisions[i2]->x)
+            else
             {
-                PlayerCollisions[i1]->x = StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX;
-                if (PlayerCollisions[i1]->velocity < 0)
+                // Test the player against every platform at once and keep the ones it touches
+                overlapAABBs(minX, minY, maxX, maxY, StaticEntityBounds, platform_mask);
+                for (size_t word = 0; word < platform_mask.size(); ++word)
                 {
-                    PlayerCollisions[i1]->velocity = 0;
+                    for (uint64_t bits = platform_mask[word]; bits != 0; bits &= bits - 1)
+                    {
+                        size_t i2 = word * 64 + std::countr_zero(bits);
+                        obstacles.push_back(StaticEntityBounds.minX[i2], StaticEntityBounds.minY[i2], StaticEntityBounds.maxX[i2], StaticEntityBounds.maxY[i2]);
+                    }
                 }
             }
-            else if (PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX > StaticEntityCollisions[i2]->x && // left of platform collision.
-                PlayerCollisions[i1]->x_before + PlayerCollisions[i1]->sizeX < StaticEntityCollisions[i2]->x &&
-                PlayerCollisions[i1]->y < StaticEntityCollisions[i2]->y + (StaticEntityCollisions[i2]->sizeY) &&
-                (PlayerCollisions[i1]->y > StaticEntityCollisions[i2]->y || PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > StaticEntityCollisions[i2]->y) &&
-                PlayerCollisions[i1]->x < StaticEntityCollisions[i2]->x)
+
+            // Entities always go through their tree
+            entity_candidates.clear();
+            EntityTree.query(minX, minY, maxX, maxY, entity_candidates);
+
+            for (Entity* entity : entity_candidates)
             {
-                PlayerCollisions[i1]->x = StaticEntityCollisions[i2]->x - PlayerCollisions[i1]->sizeX;
-                if (PlayerCollisions[i1]->velocity > 0)
-                {
-                    PlayerCollisions[i1]->velocity = 0;
-                }
+                obstacles.push_back(entity->x, entity->y, entity->x + entity->sizeX, entity->y + entity->sizeY);
             }
-            else if (PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX > StaticEntityCollisions[i2]->x &&
-                PlayerCollisions[i1]->x_before + PlayerCollisions[i1]->sizeX == StaticEntityCollisions[i2]->x &&
-                PlayerCollisions[i1]->y < StaticEntityCollisions[i2]->y + (StaticEntityCollisions[i2]->sizeY) &&
-                (PlayerCollisions[i1]->y > StaticEntityCollisions[i2]->y || PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > StaticEntityCollisions[i2]->y) &&
-                PlayerCollisions[i1]->x < StaticEntityCollisions[i2]->x)
+
+            // Move the player from where it was last tick to where it wants to be, stopping at the first
+            // thing it hits on each axis
+            physics_stats.platform_candidates += obstacles.size();
+            SweepHit hit = sweepAABB(player.x_before, player.y_before, position.x, position.y, size.sizeX, size.sizeY, obstacles);
+            position.x = hit.x;
+            position.y = hit.y;
+            player.contact_normal_x = hit.normalX;
+            player.contact_normal_y = hit.normalY;
+
+            if (hit.normalY == 1)
             {
-                PlayerCollisions[i1]->x = StaticEntityCollisions[i2]->x - PlayerCollisions[i1]->sizeX;
-                if (PlayerCollisions[i1]->velocity > 0)
+                player.jump_number = 0; // player touches ground so can restore jumps
+                if (player.verticle_velocity < 0)
                 {
-                    PlayerCollisions[i1]->velocity = 0;
+                    player.verticle_velocity = 0;
                 }
-            } // bottom collision:
-            else if ((PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX >= StaticEntityCollisions[i2]->x && PlayerCollisions[i1]->x <= StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX) &&
-                PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > StaticEntityCollisions[i2]->y &&
-                PlayerCollisions[i1]->y_before + PlayerCollisions[i1]->sizeY < StaticEntityCollisions[i2]->y)
+            }
+            else if (hit.normalY == -1 && player.verticle_velocity > 0)
             {
-                PlayerCollisions[i1]->y = StaticEntityCollisions[i2]->y - PlayerCollisions[i1]->sizeY;
-                if (PlayerCollisions[i1]->verticle_velocity > 0)
-                {
-                    PlayerCollisions[i1]->verticle_velocity = 0;
-                }
+                player.verticle_velocity = 0;
             }
-            else if ((PlayerCollisions[i1]->x + PlayerCollisions[i1]->sizeX >= StaticEntityCollisions[i2]->x && PlayerCollisions[i1]->x <= StaticEntityCollisions[i2]->x + StaticEntityCollisions[i2]->sizeX) &&
-                PlayerCollisions[i1]->y + PlayerCollisions[i1]->sizeY > StaticEntityCollisions[i2]->y &&
-                PlayerCollisions[i1]->y_before + PlayerCollisions[i1]->sizeY == StaticEntityCollisions[i2]->y)
+
+            if ((hit.normalX == 1 && player.velocity < 0) || (hit.normalX == -1 && player.velocity > 0))
             {
-                if (PlayerCollisions[i1]->verticle_velocity > 0)
-                {
-                    PlayerCollisions[i1]->verticle_velocity = 0;
-                }
-                PlayerCollisions[i1]->y = PlayerCollisions[i1]->y_before;
+                player.velocity = 0;
             }
+        }
+    }
 
+    for (uint32_t index : player_archetypes)
+    {
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (size_t row = 0; row < archetype.size(); ++row)
+        {
+            // IMPORTANT:::
+            archetype.players[row].x_before = archetype.positions[row].x;
+            archetype.players[row].y_before = archetype.positions[row].y;
         }
     }
+}
+
+// Every draw_layer is four layers of the sprite batch, drawn bottom to top
+enum DrawLayer : uint32_t
+{
+    DRAW_LAYER_STATIC_TILES,
+    DRAW_LAYER_PLATFORMS,
+    DRAW_LAYER_ENTITIES,
+    DRAW_LAYER_PLAYERS
+};
+
+// Bits of a sprite batch depth left for the creation order, below the draw_depth. Objects created
+// more than 2^26 objects apart can swap places when everything else about them is equal.
+const int draw_order_bits = SpriteBatch::DEPTH_BITS - 16;
+static_assert(draw_order_bits >= 24 && SpriteBatch::LAYER_BITS >= 10, "draw_layer and draw_depth don't fit a sprite batch key");
+
+// The sprite batch layer for part of a draw_layer
+uint32_t batchLayer(int draw_layer, DrawLayer part)
+{
+    return uint32_t(std::clamp(draw_layer, -128, 127) + 128) * 4 + part;
+}
+
+// The sprite batch depth of an object: its draw_depth, then the order it was created in
+uint64_t batchDepth(const RenderComponent& render)
+{
+    return (uint64_t(std::clamp(render.draw_depth, -32768, 32767) + 32768) << draw_order_bits)
+        | (render.draw_order & ((uint64_t(1) << draw_order_bits) - 1));
+}
+
+// Puts an object's rectangle for this frame in rects[i]: players part of the way between the last two ticks,
+// texture offsets for textured objects
+void packDrawRect(PackedDrawRects& rects, size_t i, ComponentRow row)
+{
+    Archetype<EntityRef>& archetype = Components.archetype(row.archetype);
+    const PositionComponent& position = archetype.positions[row.row];
+    const SizeComponent& size = archetype.sizes[row.row];
+    const RenderComponent& render = archetype.renders[row.row];
+
+    long long x = position.x;
+    long long y = position.y;
+    if (archetype.mask & COMPONENT_PLAYER_PHYSICS)
+    {
+        const PlayerPhysicsComponent& player = archetype.players[row.row];
+        x = player.x_previous + (long long)((position.x - player.x_previous) * render_alpha);
+        y = player.y_previous + (long long)((position.y - player.y_previous) * render_alpha);
+    }
 
-    for (int i1 = 0; i1 < AllPlayers.size(); ++i1)
+    if (render.texture == nullptr)
+    {
+        rects.set(i, double(x), double(y), double(size.sizeX), double(size.sizeY));
+    }
+    else
     {
-        // IMPORTANT:::
-        AllPlayers[i1]->x_before = AllPlayers[i1]->x;
-        AllPlayers[i1]->y_before = AllPlayers[i1]->y;
+        rects.set(i, double(x), double(y), double(size.sizeX), double(size.sizeY), double(render.x_texture_offset),
+            double(render.y_texture_offset), double(render.sizex_texture_offset), double(render.sizey_texture_offset));
     }
 }
 
-void draw_screen()
+// Queues one object for drawing at dst
+void queueSprite(SpriteBatch& batch, ComponentRow row, const SDL_Rect& dst)
 {
-    for (int i = 0; i < AllEntities.size(); i++)
+    Archetype<EntityRef>& archetype = Components.archetype(row.archetype);
+    RenderComponent& render = archetype.renders[row.row];
+
+    DrawLayer part = DRAW_LAYER_ENTITIES;
+    if (archetype.mask & COMPONENT_STATIC)
     {
-        if (AllEntities[i].second == ENTITY)
-        {
-            Entity** entityPtr = std::get_if<Entity*>(&AllEntities[i].first);
+        part = DRAW_LAYER_PLATFORMS;
+    }
+    else if (archetype.mask & COMPONENT_PLAYER_PHYSICS)
+    {
+        part = DRAW_LAYER_PLAYERS;
+    }
+    uint32_t layer = batchLayer(render.draw_layer, part);
+    uint64_t depth = batchDepth(render);
 
-            if ((**entityPtr).texture != nullptr)
-            {
-                (**entityPtr).draw_tex((**entityPtr).x_texture_offset, (**entityPtr).y_texture_offset, (**entityPtr).sizex_texture_offset, (**entityPtr).sizey_texture_offset);
-            }
-            else
-            {
-                (**entityPtr).draw((**entityPtr).x_texture_offset, (**entityPtr).y_texture_offset, (**entityPtr).sizex_texture_offset, (**entityPtr).sizey_texture_offset);
-            }
+    if (render.texture == nullptr)
+    {
+        SDL_Color colour = { render.Colour[0], render.Colour[1], render.Colour[2], render.Colour[3] };
+        batch.addRect(layer, depth, dst, colour);
+        return;
+    }
+
+    SDL_Rect src;
+    if (render.texture->getSDLTexture() != nullptr && render.texture->getSourceRect(src))
+    {
+        batch.addSprite(layer, depth, render.texture->getSDLTexture(), render.texture->getSDLTextureWidth(), render.texture->getSDLTextureHeight(),
+            src, dst, render.texture->getFlip());
+    }
+}
+
+// Which platforms findPlatforms() hands out
+enum PlatformSelection
+{
+    PLATFORMS_ALL,
+    PLATFORMS_STILL, // the ones the static layer cache keeps: in draw_layer 0, under its tiles
+    PLATFORMS_ANIMATED // the ones it can't: their texture changes every few frames, they are in another draw_layer,
+                       // or they are partly transparent and the renderer can't draw tiles premultiplied
+};
+
+// Appends the rows of the platforms in a box of the world to rows, in no particular order; the sprite batch sorts them
+void findPlatforms(long long minX, long long minY, long long maxX, long long maxY, PlatformSelection selection, std::vector<ComponentRow>& rows)
+{
+    static std::vector<StaticEntity*> nearby_platforms;
+    nearby_platforms.clear();
+    StaticEntityDrawGrid.query(minX, minY, maxX, maxY, nearby_platforms);
 
+    for (StaticEntity* platform : nearby_platforms)
+    {
+        ComponentRow row = Components.location(platform->component_handle);
+        const RenderComponent& render = Components.archetype(row.archetype).renders[row.row];
+        bool opaque = render.texture == nullptr ? render.Colour[3] == 255 : !render.texture->isTranslucent();
+        bool cacheable = render.draw_layer == 0
+            && (platform->texture == nullptr || !platform->texture->isAnimated())
+            && (opaque || static_layer_cache.premultiplied());
+        if (selection == PLATFORMS_ALL || cacheable == (selection == PLATFORMS_STILL))
+        {
+            rows.push_back(row);
         }
-        else if (AllEntities[i].second == STATIC_ENTITY)
+    }
+}
+
+// Queues every row that shows in area when drawn through transform, returns how many didn't
+unsigned long long queueRows(SpriteBatch& batch, const std::vector<ComponentRow>& rows, const ScreenTransform& transform, const SDL_Rect& area)
+{
+    // Every rectangle goes to pixels in one pass. Converting to whole pixels rounds towards 0, so a rectangle
+    // drawn into a static layer cache tile could come out a pixel away from the same one drawn straight to the
+    // screen; moving everything far to the right and down first makes it round down everywhere. transformRects()
+    // keeps its results within half the int range, so taking the bias off again can't overflow.
+    const int bias = 1 << 20;
+    ScreenTransform shifted = transform;
+    shifted.translateX += bias;
+    shifted.translateY += bias;
+
+    // recordFrame() and submitFrame() run at the same time in main_loop(), each needs its own
+    thread_local PackedDrawRects world_rects;
+    thread_local std::vector<PixelRect> screen_rects;
+    world_rects.resize(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        packDrawRect(world_rects, i, rows[i]);
+    }
+    transformRects(shifted, world_rects, screen_rects);
+
+    unsigned long long culled = 0;
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        SDL_Rect dst = { screen_rects[i].x - bias, screen_rects[i].y - bias, screen_rects[i].w, screen_rects[i].h };
+        if (dst.x >= area.x + area.w || dst.y >= area.y + area.h || dst.x + dst.w <= area.x || dst.y + dst.h <= area.y)
         {
-            StaticEntity** entityPtr = std::get_if<StaticEntity*>(&AllEntities[i].first);
+            ++culled;
+            continue;
+        }
+        queueSprite(batch, rows[i], dst);
+    }
+    return culled;
+}
 
-            if ((**entityPtr).texture != nullptr)
-            {
-                (**entityPtr).draw_tex((**entityPtr).x_texture_offset, (**entityPtr).y_texture_offset, (**entityPtr).sizex_texture_offset, (**entityPtr).sizey_texture_offset);
-            }
-            else
+// Draws the still platforms in a box of the world into a static layer cache tile, the render target
+void drawStaticTile(const ScreenTransform& transform, double minX, double minY, double maxX, double maxY)
+{
+    // texture offsets are in camera space, scaled differently from the world
+    double margin_x = double(static_draw_margin) * transform.offsetScaleX / transform.scaleX;
+    double margin_y = double(static_draw_margin) * transform.offsetScaleY / transform.scaleY;
+
+    static std::vector<ComponentRow> rows;
+    rows.clear();
+    findPlatforms((long long)std::floor(minX - margin_x), (long long)std::floor(minY - margin_y),
+        (long long)std::ceil(maxX + margin_x), (long long)std::ceil(maxY + margin_y), PLATFORMS_STILL, rows);
+
+    static SpriteBatch batch;
+    SDL_Rect tile = { 0, 0, StaticLayerCache::TILE_SIZE, StaticLayerCache::TILE_SIZE };
+    queueRows(batch, rows, transform, tile);
+    batch.flush(renderer);
+}
+
+// Records what every camera sees into commands: the players and entities, which the simulation moves.
+// Platforms are left to submitFrame(). Touches no SDL state, so main_loop() runs it on the simulation
+// thread while the main thread submits the frame before.
+void recordFrame(RenderCommandList& commands)
+{
+    // Players and entities, in whatever order Components has them; the sprite batch puts them in draw order.
+    // Only rebuilt when objects are added, removed or change archetype. Platforms come from StaticEntityDrawGrid.
+    static std::vector<ComponentRow> draw_list;
+    static uint32_t draw_list_version = UINT32_MAX;
+    if (draw_list_version != Components.version())
+    {
+        draw_list.clear();
+        for (uint32_t index : Components.query(COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_RENDER, COMPONENT_STATIC))
+        {
+            for (uint32_t row = 0; row < Components.archetype(index).size(); ++row)
             {
-                (**entityPtr).draw((**entityPtr).x_texture_offset, (**entityPtr).y_texture_offset, (**entityPtr).sizex_texture_offset, (**entityPtr).sizey_texture_offset);
+                draw_list.push_back({ index, row });
             }
+        }
+        draw_list_version = Components.version();
+    }
+
+    commands.clear();
+    for (const Camera& camera : Cameras)
+    {
+        ViewCommands& view = commands.addView(camera.view());
+        view.culled = queueRows(view.sprites, draw_list, view.view.screenTransform(), view.view.viewport);
+    }
+}
+
+// Adds the platforms to recorded commands and draws them. Platforms only change on the main thread, so they
+// are read here rather than recorded: still ones come as tiles from the static layer cache when it can take
+// the view, the rest are queued one by one. Main thread only.
+void submitFrame(RenderCommandList& commands)
+{
+    render_stats = {};
+    static_layer_cache.beginFrame();
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        ViewCommands& commands_for_view = commands[i];
+        const ViewTransform& view = commands_for_view.view;
+        const ScreenTransform transform = view.screenTransform();
+
+        // Everything on screen is queued first, sorted by layer, texture and depth and drawn in a few
+        // SDL_RenderGeometry calls, one per layer and texture
+        SpriteBatch& batch = commands_for_view.sprites;
+        bool cached = static_layer_caching
+            && static_layer_cache.queue(renderer, transform, view.viewport, batch,
+                batchLayer(0, DRAW_LAYER_STATIC_TILES), drawStaticTile);
+
+        // Platforms near the viewport, the query widened by the largest platform texture offset
+        static std::vector<ComponentRow> rows;
+        rows.clear();
+        long long view_min_x, view_min_y, view_max_x, view_max_y;
+        view.visibleWorld(double(static_draw_margin), view_min_x, view_min_y, view_max_x, view_max_y);
+        findPlatforms(view_min_x, view_min_y, view_max_x, view_max_y, cached ? PLATFORMS_ANIMATED : PLATFORMS_ALL, rows);
+
+        unsigned long long culled = commands_for_view.culled + (cached ? 0 : StaticEntityDrawGrid.size() - rows.size());
+        culled += queueRows(batch, rows, transform, view.viewport);
+
+        // sprites reaching past the edge of a split-screen viewport mustn't draw over the one next to it
+        SDL_RenderSetClipRect(renderer, &view.viewport);
+        batch.flush(renderer);
+        render_stats.sprites += batch.spritesDrawn();
+        render_stats.culled += culled;
+        render_stats.draw_calls += batch.drawCalls();
+    }
+    render_stats.static_tiles = static_layer_cache.tilesQueued();
+    render_stats.static_tiles_redrawn = static_layer_cache.tilesDrawn();
+    SDL_RenderSetClipRect(renderer, nullptr);
+}
+
+// Records and draws a frame in one go, on this thread
+void draw_screen()
+{
+    static RenderCommandList commands;
+    recordFrame(commands);
+    submitFrame(commands);
+}
+
+// Gives each camera its viewport and players: the whole window and everyone, or one player each in split-screen
+void layoutCameras()
+{
+    size_t count = split_screen ? std::clamp(AllPlayers.size(), size_t(1), max_split_screen_cameras) : 1;
+    Cameras.resize(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        Camera& camera = Cameras[i];
+        camera.follow.clear();
+        if (split_screen && i < AllPlayers.size())
+        {
+            camera.follow.push_back(AllPlayers[i]);
+        }
 
+        // two players side by side, three or four in quarters
+        if (count == 1)
+        {
+            camera.viewport = { 0, 0, SCREEN_X, SCREEN_Y };
+        }
+        else if (count == 2)
+        {
+            camera.viewport = { int(i) * (SCREEN_X / 2), 0, SCREEN_X / 2, SCREEN_Y };
+        }
+        else
+        {
+            camera.viewport = { int(i % 2) * (SCREEN_X / 2), int(i / 2) * (SCREEN_Y / 2), SCREEN_X / 2, SCREEN_Y / 2 };
         }
-        else if (AllEntities[i].second == PLAYER)
+    }
+
+    // players past the last viewport go in with the last camera's player
+    if (split_screen)
+    {
+        for (size_t i = count; i < AllPlayers.size(); ++i)
         {
-            Player** entityPtr = std::get_if<Player*>(&AllEntities[i].first);
+            Cameras.back().follow.push_back(AllPlayers[i]);
+        }
+    }
+}
 
-            if ((**entityPtr).texture != nullptr)
-            {
-                (**entityPtr).draw_tex((**entityPtr).x_texture_offset, (**entityPtr).y_texture_offset, (**entityPtr).sizex_texture_offset, (**entityPtr).sizey_texture_offset);
-            }
-            else
-            {
-                (**entityPtr).draw((**entityPtr).x_texture_offset, (**entityPtr).y_texture_offset, (**entityPtr).sizex_texture_offset, (**entityPtr).sizey_texture_offset);
-            }
+// Moves every camera once, seconds after the last frame. In the menu they stay where they are.
+void update_cameras(double seconds)
+{
+    layoutCameras();
 
+    const double units_per_pixel = double(max_X) / SCREEN_X;
+    for (Camera& camera : Cameras)
+    {
+        if (quit || AllPlayers.empty())
+        {
+            camera.hold(units_per_pixel);
+            continue;
         }
+
+        std::pair<long long, long long> mid = camera.follow.empty() ? find_midpoint(AllPlayers) : find_midpoint(camera.follow);
+        double spread = camera.follow.empty() ? findLongestDistance(AllPlayers) : findLongestDistance(camera.follow);
+        camera.update(camera_settings, double(mid.first), double(mid.second), spread, seconds, units_per_pixel);
     }
 }
 
@@ -787,28 +1483,28 @@ void PlayerSelection(bool remove)
                 switch (i)
                 {
                 case 0:
-                    box = new StaticEntity(0, 54000, 48000, 54000, 120, 100, 240, 255);
+                    box = spawn<StaticEntity>(0, 54000, 48000, 54000, 120, 100, 240, 255);
                     break;
                 case 1:
-                    box = new StaticEntity(48000, 54000, 48000, 54000, 130, 90, 240, 255);
+                    box = spawn<StaticEntity>(48000, 54000, 48000, 54000, 130, 90, 240, 255);
                     break;
                 case 2:
-                    box = new StaticEntity(96000, 54000, 48000, 54000, 140, 80, 240, 255);
+                    box = spawn<StaticEntity>(96000, 54000, 48000, 54000, 140, 80, 240, 255);
                     break;
                 case 3:
-                    box = new StaticEntity(144000, 54000, 48000, 54000, 150, 70, 240, 255);
+                    box = spawn<StaticEntity>(144000, 54000, 48000, 54000, 150, 70, 240, 255);
                     break;
                 case 4:
-                    box = new StaticEntity(0, 0, 48000, 54000, 160, 60, 240, 255);
+                    box = spawn<StaticEntity>(0, 0, 48000, 54000, 160, 60, 240, 255);
                     break;
                 case 5:
-                    box = new StaticEntity(48000, 0, 48000, 54000, 170, 50, 240, 255);
+                    box = spawn<StaticEntity>(48000, 0, 48000, 54000, 170, 50, 240, 255);
                     break;
                 case 6:
-                    box = new StaticEntity(96000, 0, 48000, 54000, 180, 40, 240, 255);
+                    box = spawn<StaticEntity>(96000, 0, 48000, 54000, 180, 40, 240, 255);
                     break;
                 case 7:
-                    box = new StaticEntity(144000, 0, 48000, 54000, 190, 30, 240, 255);
+                    box = spawn<StaticEntity>(144000, 0, 48000, 54000, 190, 30, 240, 255);
                     break;
                 default:
                     break;
@@ -843,7 +1539,7 @@ void PlayerSelection(bool remove)
 
         if (it != player_boxes.end())
         {
-            delete it->first;
+            despawn(it->first);
             player_boxes.erase(it);
         }
     }
@@ -853,7 +1549,7 @@ void PlayerSelection(bool remove)
     {
         for (auto& pair : player_boxes)
         {
-            delete pair.first;
+            despawn(pair.first);
         }
         player_boxes.clear();
     }
@@ -1165,112 +1861,786 @@ void handleEventsMenu()
 }
 
 
-void GAME_ENGINE_API main_loop()
+void GAME_ENGINE_API set_physics_tick_rate(int ticks_per_second)
 {
-    Timer<60> fps_cap_timer;
-    // While application is running
-    quit = false;
-    while (!quit)
+    if (ticks_per_second > 0)
     {
-        // Handle events on queue
-        for (int i = 0; i < controllers_playing.size(); ++i)
-        {
-            handleControllerEvents(controllers_playing[i], AllPlayers[i]);
-        }
+        physics_tick_rate = ticks_per_second;
+    }
+}
+
+void GAME_ENGINE_API inject_input(Player* player, double acceleration, bool jumping)
+{
+    player->acceleration = acceleration;
+    if (jumping)
+    {
+        jump(player);
+    }
+}
 
-        // Clear screen
-        SDL_SetRenderDrawColor(renderer, 0xF0, 0x00, 0xF0, 0xFF);
-        SDL_RenderClear(renderer);
+PhysicsStats GAME_ENGINE_API get_physics_stats()
+{
+    return physics_stats;
+}
 
-        physics();
+RenderStats GAME_ENGINE_API get_render_stats()
+{
+    return render_stats;
+}
 
-        draw_screen();
+void GAME_ENGINE_API set_split_screen(bool split)
+{
+    split_screen = split;
+    layoutCameras();
+}
 
-        // Update screen
-        SDL_RenderPresent(renderer);
+void GAME_ENGINE_API set_camera_zoom(double min_magnification, double max_magnification)
+{
+    camera_settings.min_magnification = min_magnification;
+    camera_settings.max_magnification = std::max(min_magnification, max_magnification);
+}
 
-        fps_cap_timer.sleep();
+void GAME_ENGINE_API set_static_layer_cache(bool on)
+{
+    static_layer_caching = on;
+    if (!on)
+    {
+        static_layer_cache.clear();
     }
+}
 
-    // Destroy renderer and window
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+size_t GAME_ENGINE_API get_camera_count()
+{
+    return Cameras.size();
+}
 
-    IMG_Quit();
+ViewTransform GAME_ENGINE_API get_camera_view(size_t camera)
+{
+    return Cameras[camera < Cameras.size() ? camera : 0].view();
+}
 
-    // Quit SDL subsystems
-    SDL_Quit();
+void GAME_ENGINE_API reserve_entities(size_t entities, size_t static_entities, size_t players)
+{
+    EntityPool.reserve(entities);
+    StaticEntityPool.reserve(static_entities);
+    PlayerPool.reserve(players);
+    Texture::reservePool(entities + static_entities + players);
+
+    AllEntities.reserve(entities + static_entities + players);
+    EntityCollisions.reserve(entities);
+    StaticEntityCollisions.reserve(static_entities);
+    PlayerCollisions.reserve(players);
+    AllPlayers.reserve(players);
+
+    // Objects are made without collisions and move to the colliding archetype when they are turned on
+    const ComponentMask common = COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_RENDER;
+    for (ComponentMask collision : { ComponentMask(0), ComponentMask(COMPONENT_COLLISION) })
+    {
+        Components.reserve(common | collision, entities);
+        Components.reserve(common | COMPONENT_STATIC | collision, static_entities);
+        Components.reserve(common | COMPONENT_PLAYER_PHYSICS | collision, players);
+    }
+    Components.reserveHandles(entities + static_entities + players);
+    EntityTree.reserve(entities);
+    StaticEntityGrid.reserve(static_entities);
+    StaticEntityDrawGrid.reserve(static_entities);
 }
 
-void GAME_ENGINE_API init()
+// Loads and unloads files for world streaming, kept out of SourceH.h so only the engine has one
+static ChunkStreamer chunk_streamer;
+
+// The mapbg DLLs chunk_streamer has decoded images from. It keeps them loaded until streaming
+// stops, so the platforms made from those images don't load the DLL again on the main thread.
+static std::vector<HMODULE> streaming_modules;
+
+// chunk_streamer's DecodeImage, runs on its thread
+SDL_Surface* decodeChunkImage(int32_t resourceID)
 {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
+    HMODULE module = loadMapBackgroundDLL(resourceID);
+    if (module != nullptr)
     {
-        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+        if (std::find(streaming_modules.begin(), streaming_modules.end(), module) != streaming_modules.end())
+        {
+            FreeLibrary(module); // already holding it
+        }
+        else
+        {
+            streaming_modules.push_back(module);
+        }
     }
+    return Texture::decodeResource(module, resourceID);
+}
 
-    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
-        std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
+// Simulates and records frames for main_loop() while it draws
+static JobThread simulation_thread;
+
+uint64_t chunkKey(ChunkCoord chunk)
+{
+    return (uint64_t(uint32_t(chunk.x)) << 32) | uint32_t(chunk.y);
+}
+
+// Creates the platforms of a chunk whose records have been read, taking the records. images are
+// the ones chunk_streamer decoded for them (if any), so only uploading them is left; they're freed.
+void chunkLoaded(StreamedChunk& chunk, std::vector<StaticEntityDesc>& records, std::vector<DecodedImage>& images)
+{
+    chunk.records.swap(records);
+    chunk.platforms.resize(chunk.records.size());
+    createStaticEntities(chunk.records.data(), chunk.records.size(), chunk.platforms.data(), &images);
+    chunk.loaded = true;
+
+    for (DecodedImage& image : images)
+    {
+        SDL_FreeSurface(image.surface);
     }
+    images.clear();
+}
 
-    // Create a window
-    window = SDL_CreateWindow("Gun Mayhem",
-        SDL_WINDOWPOS_CENTERED,
-        SDL_WINDOWPOS_CENTERED,
-        SCREEN_X, SCREEN_Y,
-        SDL_WINDOW_SHOWN);
+// Destroys a chunk's platforms, queueing a save first if any of them changed since the chunk loaded
+void unloadChunk(StreamedChunk& chunk)
+{
+    std::vector<StaticEntityDesc> current(chunk.platforms.size());
+    for (size_t i = 0; i < chunk.platforms.size(); ++i)
+    {
+        const StaticEntity* platform = chunk.platforms[i];
+        StaticEntityDesc& desc = current[i];
+        desc.x = platform->x;
+        desc.y = platform->y;
+        desc.sizeX = platform->sizeX;
+        desc.sizeY = platform->sizeY;
+        for (int c = 0; c < 4; ++c)
+        {
+            desc.colour[c] = platform->Colour[c];
+        }
+        desc.resourceID = chunk.records[i].resourceID;
+        desc.flags = StaticEntityCollisions.contains(platform->collision_handle) ? STATIC_ENTITY_COLLISIONS : 0;
+    }
 
-    if (window == nullptr) {
-        std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-        SDL_Quit();
+    if (current.size() != chunk.records.size()
+        || (!current.empty() && std::memcmp(current.data(), chunk.records.data(), current.size() * sizeof(StaticEntityDesc)) != 0))
+    {
+        chunk_streamer.requestSave(chunk.coord, std::move(current));
     }
 
-    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
+    for (StaticEntity* platform : chunk.platforms)
+    {
+        despawn(platform);
+    }
+    chunk.platforms.clear();
+    chunk.loaded = false;
+}
 
-    // Create a renderer for the window
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (renderer == nullptr) {
-        std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-        SDL_DestroyWindow(window);
-        SDL_Quit();
+// Called once per frame: creates the platforms of chunks that finished loading, asks for the
+// chunks that came into range and unloads the ones that went out of it
+void updateWorldStreaming()
+{
+    if (!chunk_streamer.running())
+    {
+        return;
     }
 
-    std::cout << "Number of Controllers: " << SDL_NumJoysticks() << std::endl;
+    ChunkCoord coord;
+    static std::vector<StaticEntityDesc> records;
+    static std::vector<DecodedImage> images;
+    while (chunk_streamer.pollLoaded(coord, records, images))
+    {
+        // skip chunks dropped while they were loading, and repeat loads of one already filled in
+        auto found = WorldChunks.find(chunkKey(coord));
+        if (found != WorldChunks.end() && !found->second.loaded)
+        {
+            chunkLoaded(found->second, records, images);
+        }
+        for (DecodedImage& image : images)
+        {
+            SDL_FreeSurface(image.surface);
+        }
+        images.clear();
+    }
 
-    // Initialize the controller
-    if (SDL_NumJoysticks() > 0) {
-        for (int i = 0; i < SDL_NumJoysticks(); ++i)
+    std::pair<long long, long long> mid = find_midpoint();
+    ChunkCoord centre = { chunkOf(mid.first), chunkOf(mid.second) };
+    for (int dy = -stream_radius; dy <= stream_radius; ++dy)
+    {
+        for (int dx = -stream_radius; dx <= stream_radius; ++dx)
         {
-            if (SDL_IsGameController(i)) {
-                controllers.push_back(SDL_GameControllerOpen(i));
-                if (controllers[i])
-                {
-                    std::cout << "Controller connected: " << SDL_GameControllerName(controllers[i]) << std::endl;
-                }
-                else
-                {
-                    std::cerr << "Could not open game controller! SDL_Error: " << SDL_GetError() << std::endl;
-                }
+            ChunkCoord chunk = { centre.x + dx, centre.y + dy };
+            auto inserted = WorldChunks.try_emplace(chunkKey(chunk));
+            if (inserted.second)
+            {
+                inserted.first->second.coord = chunk;
+                chunk_streamer.requestLoad(chunk);
             }
         }
     }
 
-    // add variables
+    // Chunks go one chunk further out than they come in, so moving back and forth over
+    // a chunk border doesn't load and unload the same chunk every frame
+    for (auto it = WorldChunks.begin(); it != WorldChunks.end();)
+    {
+        const ChunkCoord& chunk = it->second.coord;
+        if (std::abs(chunk.x - centre.x) > stream_radius + 1 || std::abs(chunk.y - centre.y) > stream_radius + 1)
+        {
+            if (it->second.loaded)
+            {
+                unloadChunk(it->second);
+            }
+            it = WorldChunks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
 
-    StaticEntity platform2(100000, 1500, 50000, 20000);
-    platform2.CollisionsOn();
+void GAME_ENGINE_API enable_world_streaming(const std::string& directory, int radius)
+{
+    disable_world_streaming();
+    stream_radius = radius;
+    // no textures to decode for in headless mode
+    chunk_streamer.start(directory, headless ? nullptr : decodeChunkImage);
+
+    // The chunks around the players are read straight away, so nobody falls through the floor
+    // while the first loads are still on the background thread
+    std::pair<long long, long long> mid = find_midpoint();
+    ChunkCoord centre = { chunkOf(mid.first), chunkOf(mid.second) };
+    std::vector<StaticEntityDesc> records;
+    std::vector<DecodedImage> images;
+    for (int dy = -stream_radius; dy <= stream_radius; ++dy)
+    {
+        for (int dx = -stream_radius; dx <= stream_radius; ++dx)
+        {
+            ChunkCoord chunk = { centre.x + dx, centre.y + dy };
+            readLevelFile(chunk_streamer.path(chunk), records);
 
-    StaticEntity platform3(65000, 35000, 50000, 20000);
-    platform3.CollisionsOn();
+            StreamedChunk& streamed = WorldChunks[chunkKey(chunk)];
+            streamed.coord = chunk;
+            chunkLoaded(streamed, records, images);
+        }
+    }
 }
 
-Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY)
+void GAME_ENGINE_API disable_world_streaming()
 {
+    if (!chunk_streamer.running())
+    {
+        return;
+    }
 
-    x_texture_offset = 0;
-    y_texture_offset = 0;
-    sizex_texture_offset = 0;
-    sizey_texture_offset = 0;
+    for (auto& entry : WorldChunks)
+    {
+        if (entry.second.loaded)
+        {
+            unloadChunk(entry.second);
+        }
+    }
+    WorldChunks.clear();
+
+    // waits for the saves queued above
+    chunk_streamer.stop();
+
+    for (HMODULE module : streaming_modules)
+    {
+        FreeLibrary(module);
+    }
+    streaming_modules.clear();
+}
+
+// Layout of a WorldSnapshot: this header on the first page, then the player records from
+// player_offset and the entity records from entity_offset, both page aligned
+struct SnapshotHeader
+{
+    uint32_t magic; // SNAPSHOT_MAGIC
+    uint32_t version; // SNAPSHOT_VERSION
+    uint32_t player_count;
+    uint32_t entity_count;
+    uint64_t player_offset;
+    uint64_t entity_offset;
+};
+
+const uint32_t SNAPSHOT_MAGIC = 0x50414E53; // "SNAP"
+const uint32_t SNAPSHOT_VERSION = 1;
+
+// Everything physics() reads or changes about a player. No padding, so equal states are equal bytes.
+struct PlayerSnapshot
+{
+    SlotHandle handle; // entity_handle
+    int64_t x, y;
+    int64_t x_before, y_before;
+    int64_t x_previous, y_previous;
+    double acceleration;
+    double velocity;
+    double velocity_pp_collision;
+    double velocity_max;
+    double gravity_acceleration;
+    double verticle_nongravity_acceleration;
+    double verticle_velocity;
+    double verticle_velocity_max;
+    int32_t jump_number;
+    int32_t contact_normal_x;
+    int32_t contact_normal_y;
+    uint32_t triple_jump;
+};
+
+struct EntitySnapshot
+{
+    SlotHandle handle; // entity_handle
+    int64_t x, y;
+    uint32_t sizeX, sizeY;
+};
+
+size_t roundUpToPage(size_t bytes)
+{
+    return (bytes + WorldSnapshot::PAGE_SIZE - 1) / WorldSnapshot::PAGE_SIZE * WorldSnapshot::PAGE_SIZE;
+}
+
+WorldSnapshot::~WorldSnapshot()
+{
+    if (mData != nullptr)
+    {
+        ::operator delete(mData, std::align_val_t(PAGE_SIZE));
+    }
+}
+
+void WorldSnapshot::resize(size_t byteCount)
+{
+    if (byteCount > mCapacity)
+    {
+        if (mData != nullptr)
+        {
+            ::operator delete(mData, std::align_val_t(PAGE_SIZE));
+        }
+        mData = (unsigned char*)::operator new(byteCount, std::align_val_t(PAGE_SIZE));
+        mCapacity = byteCount;
+    }
+    mSize = byteCount;
+}
+
+void WorldSnapshot::capture()
+{
+    const std::vector<uint32_t>& entity_archetypes = Components.query(COMPONENT_POSITION, COMPONENT_STATIC | COMPONENT_PLAYER_PHYSICS);
+    size_t entity_count = 0;
+    for (uint32_t index : entity_archetypes)
+    {
+        entity_count += Components.archetype(index).size();
+    }
+
+    size_t player_offset = roundUpToPage(sizeof(SnapshotHeader));
+    size_t player_end = player_offset + AllPlayers.size() * sizeof(PlayerSnapshot);
+    size_t entity_offset = roundUpToPage(player_end);
+    size_t entity_end = entity_offset + entity_count * sizeof(EntitySnapshot);
+    resize(roundUpToPage(entity_end));
+
+    // the gaps are zeroed too, so the same state always gives the same bytes
+    std::memset(mData, 0, player_offset);
+    std::memset(mData + player_end, 0, entity_offset - player_end);
+    std::memset(mData + entity_end, 0, mSize - entity_end);
+
+    SnapshotHeader* header = (SnapshotHeader*)mData;
+    header->magic = SNAPSHOT_MAGIC;
+    header->version = SNAPSHOT_VERSION;
+    header->player_count = uint32_t(AllPlayers.size());
+    header->entity_count = uint32_t(entity_count);
+    header->player_offset = player_offset;
+    header->entity_offset = entity_offset;
+
+    PlayerSnapshot* player_records = (PlayerSnapshot*)(mData + player_offset);
+    for (Player* player : AllPlayers)
+    {
+        PlayerSnapshot& record = *player_records++;
+        record.handle = player->entity_handle;
+        record.x = player->x;
+        record.y = player->y;
+        record.x_before = player->x_before;
+        record.y_before = player->y_before;
+        record.x_previous = player->x_previous;
+        record.y_previous = player->y_previous;
+        record.acceleration = player->acceleration;
+        record.velocity = player->velocity;
+        record.velocity_pp_collision = player->velocity_pp_collision;
+        record.velocity_max = player->velocity_max;
+        record.gravity_acceleration = player->gravity_acceleration;
+        record.verticle_nongravity_acceleration = player->verticle_nongravity_acceleration;
+        record.verticle_velocity = player->verticle_velocity;
+        record.verticle_velocity_max = player->verticle_velocity_max;
+        record.jump_number = player->jump_number;
+        record.contact_normal_x = player->contact_normal_x;
+        record.contact_normal_y = player->contact_normal_y;
+        record.triple_jump = player->TripleJump;
+    }
+
+    EntitySnapshot* entity_records = (EntitySnapshot*)(mData + entity_offset);
+    for (uint32_t index : entity_archetypes)
+    {
+        Archetype<EntityRef>& archetype = Components.archetype(index);
+        for (const EntityRef& owner : archetype.owners)
+        {
+            const Entity* entity = std::get<Entity*>(owner.first);
+            EntitySnapshot& record = *entity_records++;
+            record.handle = entity->entity_handle;
+            record.x = entity->x;
+            record.y = entity->y;
+            record.sizeX = entity->sizeX;
+            record.sizeY = entity->sizeY;
+        }
+    }
+}
+
+// The object a snapshot record belongs to, nullptr if it has been destroyed since
+template <typename T>
+T* snapshotOwner(SlotHandle handle, EntityType type)
+{
+    const EntityRef* owner = AllEntities.get(handle);
+    if (owner == nullptr || owner->second != type)
+    {
+        return nullptr;
+    }
+    return std::get<T*>(owner->first);
+}
+
+bool WorldSnapshot::restore() const
+{
+    if (mSize < sizeof(SnapshotHeader))
+    {
+        return false;
+    }
+
+    const SnapshotHeader* header = (const SnapshotHeader*)mData;
+    const PlayerSnapshot* player_records = (const PlayerSnapshot*)(mData + header->player_offset);
+    const EntitySnapshot* entity_records = (const EntitySnapshot*)(mData + header->entity_offset);
+
+    // check everything first, so a failed restore doesn't leave the world half rolled back
+    for (uint32_t i = 0; i < header->player_count; ++i)
+    {
+        if (snapshotOwner<Player>(player_records[i].handle, PLAYER) == nullptr)
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->entity_count; ++i)
+    {
+        if (snapshotOwner<Entity>(entity_records[i].handle, ENTITY) == nullptr)
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->player_count; ++i)
+    {
+        const PlayerSnapshot& record = player_records[i];
+        Player* player = snapshotOwner<Player>(record.handle, PLAYER);
+        player->x = record.x;
+        player->y = record.y;
+        player->x_before = record.x_before;
+        player->y_before = record.y_before;
+        player->x_previous = record.x_previous;
+        player->y_previous = record.y_previous;
+        player->acceleration = record.acceleration;
+        player->velocity = record.velocity;
+        player->velocity_pp_collision = record.velocity_pp_collision;
+        player->velocity_max = record.velocity_max;
+        player->gravity_acceleration = record.gravity_acceleration;
+        player->verticle_nongravity_acceleration = record.verticle_nongravity_acceleration;
+        player->verticle_velocity = record.verticle_velocity;
+        player->verticle_velocity_max = record.verticle_velocity_max;
+        player->jump_number = record.jump_number;
+        player->contact_normal_x = record.contact_normal_x;
+        player->contact_normal_y = record.contact_normal_y;
+        player->TripleJump = record.triple_jump != 0;
+    }
+
+    for (uint32_t i = 0; i < header->entity_count; ++i)
+    {
+        const EntitySnapshot& record = entity_records[i];
+        Entity* entity = snapshotOwner<Entity>(record.handle, ENTITY);
+        entity->x = record.x;
+        entity->y = record.y;
+        entity->sizeX = record.sizeX;
+        entity->sizeY = record.sizeY;
+    }
+    return true;
+}
+
+bool WorldSnapshot::load(const unsigned char* bytes, size_t byteCount)
+{
+    if (byteCount < sizeof(SnapshotHeader) || byteCount % PAGE_SIZE != 0)
+    {
+        return false;
+    }
+
+    const SnapshotHeader* header = (const SnapshotHeader*)bytes;
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION
+        || header->player_offset > byteCount || header->player_count > (byteCount - header->player_offset) / sizeof(PlayerSnapshot)
+        || header->entity_offset > byteCount || header->entity_count > (byteCount - header->entity_offset) / sizeof(EntitySnapshot))
+    {
+        return false;
+    }
+
+    resize(byteCount);
+    std::memcpy(mData, bytes, byteCount);
+    return true;
+}
+
+void WorldSnapshot::diff(const WorldSnapshot& base, std::vector<uint32_t>& changedPages) const
+{
+    changedPages.clear();
+    for (size_t page = 0; page < pageCount(); ++page)
+    {
+        size_t offset = page * PAGE_SIZE;
+        if (base.mSize != mSize || std::memcmp(mData + offset, base.mData + offset, PAGE_SIZE) != 0)
+        {
+            changedPages.push_back(uint32_t(page));
+        }
+    }
+}
+
+void WorldSnapshot::copyPages(const WorldSnapshot& source, const std::vector<uint32_t>& pages)
+{
+    resize(source.mSize);
+    for (uint32_t page : pages)
+    {
+        std::memcpy(mData + size_t(page) * PAGE_SIZE, source.mData + size_t(page) * PAGE_SIZE, PAGE_SIZE);
+    }
+}
+
+void GAME_ENGINE_API step(int ticks)
+{
+    updateWorldStreaming();
+    pullComponents();
+    for (int i = 0; i < ticks; ++i)
+    {
+        physics();
+    }
+    pushComponents();
+    render_alpha = 1.0;
+}
+
+void GAME_ENGINE_API step_realtime(int ticks)
+{
+    const auto tick_length = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / physics_tick_rate));
+    auto next_tick = std::chrono::steady_clock::now();
+    updateWorldStreaming();
+    pullComponents();
+    for (int i = 0; i < ticks; ++i)
+    {
+        physics();
+        next_tick += tick_length;
+        std::this_thread::sleep_until(next_tick);
+    }
+    pushComponents();
+    render_alpha = 1.0;
+}
+
+// Simulates the game up to now for main_loop(), frame_seconds after the last frame, and records the frame into commands.
+// Runs on the simulation thread.
+void simulateFrame(double& physics_accumulator, double frame_seconds, RenderCommandList& commands)
+{
+    // Run as many fixed physics ticks as the time since the last frame covers
+    const double tick_length = 1.0 / physics_tick_rate;
+    int steps = 0;
+    pullComponents();
+    while (physics_accumulator >= tick_length && steps < max_physics_steps_per_frame)
+    {
+        physics();
+        physics_accumulator -= tick_length;
+        ++steps;
+    }
+    pushComponents();
+
+    // Too far behind to catch up, drop the time instead of trying again next frame (spiral of death)
+    if (physics_accumulator >= tick_length)
+    {
+        physics_accumulator = std::fmod(physics_accumulator, tick_length);
+    }
+
+    // Draw players part of the way between the last two ticks
+    render_alpha = physics_accumulator / tick_length;
+
+    update_cameras(frame_seconds);
+    recordFrame(commands);
+}
+
+void GAME_ENGINE_API main_loop()
+{
+    if (headless)
+    {
+        std::cerr << "main_loop() needs a window, use step() or step_realtime() in headless mode" << std::endl;
+        return;
+    }
+
+    Timer<60> fps_cap_timer;
+
+    // Real time that has passed but hasn't been simulated yet
+    double physics_accumulator = 0;
+    auto previous_time = std::chrono::steady_clock::now();
+
+    // The simulation thread simulates and records a frame into one list while this thread draws the frame
+    // before from the other and presents it, so waiting on the present doesn't hold the simulation up.
+    RenderCommandList command_lists[2];
+    int recording = 0;
+    bool recorded = false;
+
+    // While application is running
+    quit = false;
+    while (!quit)
+    {
+        // Everything here touches what the simulation reads, the simulation thread is idle until run()
+
+        // Handle events on queue
+        for (int i = 0; i < controllers_playing.size(); ++i)
+        {
+            handleControllerEvents(controllers_playing[i], AllPlayers[i]);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double frame_seconds = std::chrono::duration<double>(now - previous_time).count();
+        physics_accumulator += frame_seconds;
+        previous_time = now;
+
+        // streamed platforms are created with their textures, which needs SDL
+        updateWorldStreaming();
+
+        RenderCommandList& next_frame = command_lists[recording];
+        simulation_thread.run([&next_frame, &physics_accumulator, frame_seconds]()
+            {
+                simulateFrame(physics_accumulator, frame_seconds, next_frame);
+            });
+
+        if (recorded)
+        {
+            // Clear screen
+            SDL_SetRenderDrawColor(renderer, 0xF0, 0x00, 0xF0, 0xFF);
+            SDL_RenderClear(renderer);
+
+            submitFrame(command_lists[1 - recording]);
+
+            // Update screen
+            SDL_RenderPresent(renderer);
+        }
+
+        fps_cap_timer.sleep();
+
+        simulation_thread.wait();
+        recording = 1 - recording;
+        recorded = true;
+    }
+    simulation_thread.stop();
+
+    // Streamed platforms own textures, so they have to go before the renderer
+    disable_world_streaming();
+    Texture::releaseAtlas(renderer);
+    static_layer_cache.clear();
+
+    // Destroy renderer and window
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+
+    IMG_Quit();
+
+    // Quit SDL subsystems
+    SDL_Quit();
+}
+
+void GAME_ENGINE_API init(BroadphaseMode broadphase)
+{
+    broadphase_mode = broadphase;
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
+    {
+        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+    }
+
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
+    }
+
+    // Create a window
+    window = SDL_CreateWindow("Gun Mayhem",
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        SCREEN_X, SCREEN_Y,
+        SDL_WINDOW_SHOWN);
+
+    if (window == nullptr) {
+        std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        SDL_Quit();
+    }
+
+    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
+
+    // Create a renderer for the window
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (renderer == nullptr) {
+        std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+    }
+
+    // the cameras need their viewports before anything can be drawn
+    update_cameras(0);
+
+    std::cout << "Number of Controllers: " << SDL_NumJoysticks() << std::endl;
+
+    // Initialize the controller
+    if (SDL_NumJoysticks() > 0) {
+        for (int i = 0; i < SDL_NumJoysticks(); ++i)
+        {
+            if (SDL_IsGameController(i)) {
+                controllers.push_back(SDL_GameControllerOpen(i));
+                if (controllers[i])
+                {
+                    std::cout << "Controller connected: " << SDL_GameControllerName(controllers[i]) << std::endl;
+                }
+                else
+                {
+                    std::cerr << "Could not open game controller! SDL_Error: " << SDL_GetError() << std::endl;
+                }
+            }
+        }
+    }
+
+    // add variables
+
+    StaticEntity platform2(100000, 1500, 50000, 20000);
+    platform2.CollisionsOn();
+
+    StaticEntity platform3(65000, 35000, 50000, 20000);
+    platform3.CollisionsOn();
+}
+
+void GAME_ENGINE_API init_headless(BroadphaseMode broadphase)
+{
+    broadphase_mode = broadphase;
+    headless = true;
+    update_cameras(0);
+}
+
+void Entity::CollisionsOn()
+{
+    if (!EntityCollisions.contains(collision_handle))
+    {
+        collision_handle = EntityCollisions.insert(this);
+        collision_proxy = EntityTree.insert(this, x, y, x + sizeX, y + sizeY);
+        setCollisionComponent(component_handle, true);
+    }
+}
+
+void Entity::CollisionsOff()
+{
+    if (EntityCollisions.remove(collision_handle))
+    {
+        EntityTree.remove(collision_proxy);
+        collision_proxy = -1;
+        setCollisionComponent(component_handle, false);
+    }
+}
+
+Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY)
+{
+
+    x_texture_offset = 0;
+    y_texture_offset = 0;
+    sizex_texture_offset = 0;
+    sizey_texture_offset = 0;
 
     Colour[0] = 0xFF;
     Colour[1] = 0x00;
@@ -1284,7 +2654,8 @@ Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     EntityType ThisType = ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY, const std::string& texturePath)
@@ -1310,7 +2681,8 @@ Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     EntityType ThisType = ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY, int resourceID, bool mapbg)
@@ -1324,33 +2696,13 @@ Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     if (mapbg)
     {
-        hModule = new HMODULE;
-        if (resourceID > 100 && resourceID < 151)
-        {
-            *hModule = LoadLibrary(L"mapbg.dll");
-        }
-        else if (resourceID > 150 && resourceID < 201)
-        {
-            *hModule = LoadLibrary(L"mapbg2.dll");
-        }
-        else if (resourceID > 200 && resourceID < 251)
-        {
-            *hModule = LoadLibrary(L"mapbg3.dll");
-        }
-        else if (resourceID > 250 && resourceID < 301)
-        {
-            *hModule = LoadLibrary(L"mapbg4.dll");
-        }
-        else if (resourceID > 300 && resourceID < 351)
-        {
-            *hModule = LoadLibrary(L"mapbg5.dll");
-        }
+        hModule = loadMapBackgroundDLL(resourceID);
 
         if (hModule == NULL)
         {
             std::cerr << "Failed to load DLL!" << std::endl;
         }
-        if (!texture->loadFromResourceDLL(renderer, *hModule, resourceID))
+        if (!texture->loadFromResourceDLL(renderer, hModule, resourceID))
         {
             std::cerr << "Failed to load texture from DLL!" << std::endl;
         }
@@ -1372,7 +2724,8 @@ Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     EntityType ThisType = ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY, ColourT r, ColourT g, ColourT b, ColourT a)
@@ -1395,15 +2748,18 @@ Entity::Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, uns
 
     EntityType ThisType = ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 Entity::~Entity()
 {
+    // don't leave a dangling pointer behind for physics()
+    CollisionsOff();
+
     if (hModule != nullptr)
     {
-        FreeLibrary(*hModule);
-        delete hModule;
+        FreeLibrary(hModule);
     }
 
     if (texture != nullptr)
@@ -1411,17 +2767,68 @@ Entity::~Entity()
         delete texture;
     }
 
-    EntityType ThisType = ENTITY;
-    std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    auto it = std::find(AllEntities.begin(), AllEntities.end(), pushback);
+    AllEntities.remove(entity_handle);
+    Components.destroy(component_handle);
+}
 
-    // If the element was found, remove it
-    if (it != AllEntities.end()) {
-        AllEntities.erase(it);
+void* Entity::operator new(size_t size)
+{
+    // a class derived from Entity doesn't fit the pool's blocks
+    if (size != sizeof(Entity))
+    {
+        return ::operator new(size);
+    }
+    return EntityPool.allocate();
+}
+
+void Entity::operator delete(void* memory, size_t size)
+{
+    // sized like operator new was, so a derived object goes back to the heap it came from
+    if (size != sizeof(Entity))
+    {
+        ::operator delete(memory);
+        return;
     }
+    EntityPool.deallocate(memory);
 }
 
 
+void StaticEntity::CollisionsOn()
+{
+    if (!StaticEntityCollisions.contains(collision_handle))
+    {
+        collision_handle = StaticEntityCollisions.insert(this);
+        StaticEntityGrid.insert(this, x, y, sizeX, sizeY);
+        StaticEntityBVH.markDirty();
+        StaticEntityBoundsDirty = true;
+        setCollisionComponent(component_handle, true);
+    }
+}
+
+void StaticEntity::CollisionsOff()
+{
+    if (StaticEntityCollisions.remove(collision_handle))
+    {
+        StaticEntityGrid.remove(this);
+        StaticEntityBVH.markDirty();
+        StaticEntityBoundsDirty = true;
+        setCollisionComponent(component_handle, false);
+    }
+}
+
+void StaticEntity::changed()
+{
+    ComponentRow row = Components.location(component_handle);
+    repullPlatform(Components.archetype(row.archetype), row.row);
+    if (StaticEntityCollisions.contains(collision_handle))
+    {
+        StaticEntityGrid.remove(this);
+        StaticEntityGrid.insert(this, x, y, sizeX, sizeY);
+        StaticEntityBVH.markDirty();
+        StaticEntityBoundsDirty = true;
+    }
+}
+
 StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY)
 {
 
@@ -1442,7 +2849,8 @@ StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned in
 
     EntityType ThisType = STATIC_ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY, const std::string& texturePath)
@@ -1468,7 +2876,8 @@ StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned in
 
     EntityType ThisType = STATIC_ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY, int resourceID, bool mapbg)
@@ -1482,33 +2891,13 @@ StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned in
 
     if (mapbg)
     {
-        hModule = new HMODULE;
-        if (resourceID > 100 && resourceID < 151)
-        {
-            *hModule = LoadLibrary(L"mapbg.dll");
-        }
-        else if (resourceID > 150 && resourceID < 201)
-        {
-            *hModule = LoadLibrary(L"mapbg2.dll");
-        }
-        else if (resourceID > 200 && resourceID < 251)
-        {
-            *hModule = LoadLibrary(L"mapbg3.dll");
-        }
-        else if (resourceID > 250 && resourceID < 301)
-        {
-            *hModule = LoadLibrary(L"mapbg4.dll");
-        }
-        else if (resourceID > 300 && resourceID < 351)
-        {
-            *hModule = LoadLibrary(L"mapbg5.dll");
-        }
+        hModule = loadMapBackgroundDLL(resourceID);
 
         if (hModule == NULL)
         {
             std::cerr << "Failed to load DLL!" << std::endl;
         }
-        if (!texture->loadFromResourceDLL(renderer, *hModule, resourceID))
+        if (!texture->loadFromResourceDLL(renderer, hModule, resourceID))
         {
             std::cerr << "Failed to load texture from DLL!" << std::endl;
         }
@@ -1530,7 +2919,8 @@ StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned in
 
     EntityType ThisType = STATIC_ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
 }
 
 StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY, ColourT r, ColourT g, ColourT b, ColourT a)
@@ -1553,16 +2943,215 @@ StaticEntity::StaticEntity(long long int X_POS, long long int Y_POS, unsigned in
 
     EntityType ThisType = STATIC_ENTITY;
     std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    AllEntities.push_back(pushback);
+    entity_handle = AllEntities.insert(pushback);
+    component_handle = addComponents(pushback);
+}
+
+StaticEntity::StaticEntity(const StaticEntityDesc& desc, SDL_Surface* decoded)
+{
+    x_texture_offset = 0;
+    y_texture_offset = 0;
+    sizex_texture_offset = 0;
+    sizey_texture_offset = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        Colour[i] = desc.colour[i];
+    }
+
+    x = desc.x;
+    y = desc.y;
+    sizeX = desc.sizeX;
+    sizeY = desc.sizeY;
+
+    // no renderer to make textures with in headless mode, those platforms keep their colour
+    if (desc.resourceID != 0 && !headless)
+    {
+        texture = new Texture();
+        hModule = loadMapBackgroundDLL(desc.resourceID);
+        if (decoded != nullptr)
+        {
+            if (!texture->loadFromResourceSurface(renderer, hModule, desc.resourceID, decoded))
+            {
+                std::cerr << "Failed to load texture from decoded image!" << std::endl;
+            }
+        }
+        else if (hModule != nullptr)
+        {
+            if (!texture->loadFromResourceDLL(renderer, hModule, desc.resourceID))
+            {
+                std::cerr << "Failed to load texture from DLL!" << std::endl;
+            }
+        }
+        else
+        {
+            texture->loadFromResource(renderer, desc.resourceID);
+        }
+    }
+}
+
+// create_static_entities(), taking the platforms' images from images (if given) where they're in it
+void createStaticEntities(const StaticEntityDesc* descs, size_t count, StaticEntity** out, const std::vector<DecodedImage>* images)
+{
+    const ComponentMask static_mask = COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_RENDER | COMPONENT_STATIC;
+
+    size_t colliding = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        colliding += (descs[i].flags & STATIC_ENTITY_COLLISIONS) ? 1 : 0;
+    }
+
+    StaticEntityPool.reserve(StaticEntityPool.size() + count);
+    AllEntities.reserve(AllEntities.size() + count);
+    StaticEntityCollisions.reserve(StaticEntityCollisions.size() + colliding);
+    Components.reserve(static_mask, count - colliding);
+    Components.reserve(static_mask | COMPONENT_COLLISION, colliding);
+
+    // platforms that start with collisions on, for the grid to take in one go
+    static std::vector<StaticEntity*> colliders;
+    colliders.clear();
+    colliders.reserve(colliding);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        SDL_Surface* decoded = nullptr;
+        if (images != nullptr)
+        {
+            for (const DecodedImage& image : *images)
+            {
+                if (image.resourceID == descs[i].resourceID)
+                {
+                    decoded = image.surface;
+                    break;
+                }
+            }
+        }
+
+        StaticEntity* platform = new StaticEntity(descs[i], decoded);
+        EntityRef owner(platform, STATIC_ENTITY);
+        platform->entity_handle = AllEntities.insert(owner);
+
+        // going straight into the colliding archetype saves CollisionsOn() moving the row afterwards
+        bool collisions = (descs[i].flags & STATIC_ENTITY_COLLISIONS) != 0;
+        platform->component_handle = addComponents(owner, collisions ? COMPONENT_COLLISION : 0, false);
+        if (collisions)
+        {
+            platform->collision_handle = StaticEntityCollisions.insert(platform);
+            colliders.push_back(platform);
+        }
+        out[i] = platform;
+    }
+
+    // descriptions have no texture offsets, so the boxes are just the platforms and static_draw_margin stays as it is
+    StaticEntityDrawGrid.insert(std::vector<StaticEntity*>(out, out + count));
+
+    if (!colliders.empty())
+    {
+        StaticEntityGrid.insert(colliders);
+        StaticEntityBVH.markDirty();
+        StaticEntityBoundsDirty = true;
+    }
+}
+
+void GAME_ENGINE_API create_static_entities(const StaticEntityDesc* descs, size_t count, StaticEntity** out)
+{
+    createStaticEntities(descs, count, out, nullptr);
+}
+
+// A read-only view of a whole file, unmapped and closed when it goes out of scope
+struct MappedFile
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const unsigned char* data = nullptr;
+    unsigned long long size = 0;
+
+    bool open(const std::string& path)
+    {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            return false; // an empty file can't be mapped
+        }
+        size = (unsigned long long)fileSize.QuadPart;
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            return false;
+        }
+        data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+    }
+
+    ~MappedFile()
+    {
+        if (data != nullptr)
+        {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+    }
+};
+
+bool GAME_ENGINE_API load_level(const std::string& path, std::vector<StaticEntity*>& platforms)
+{
+    MappedFile level;
+    if (!level.open(path))
+    {
+        std::cerr << "Failed to open level " << path << std::endl;
+        return false;
+    }
+
+    if (level.size < sizeof(LevelHeader))
+    {
+        std::cerr << "Level " << path << " is too small to be a level" << std::endl;
+        return false;
+    }
+
+    const LevelHeader* header = (const LevelHeader*)level.data;
+    if (header->magic != LEVEL_MAGIC || header->version != LEVEL_VERSION || header->record_size != sizeof(StaticEntityDesc))
+    {
+        std::cerr << "Level " << path << " isn't a version " << LEVEL_VERSION << " level" << std::endl;
+        return false;
+    }
+
+    unsigned long long count = header->static_entity_count;
+    unsigned long long offset = header->static_entity_offset;
+    if (offset % alignof(StaticEntityDesc) != 0 || offset > level.size || count > (level.size - offset) / sizeof(StaticEntityDesc))
+    {
+        std::cerr << "Level " << path << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+
+    // the view is page aligned and the offset is a multiple of 8, so the records can be used in place
+    size_t first = platforms.size();
+    platforms.resize(first + count);
+    create_static_entities((const StaticEntityDesc*)(level.data + offset), count, platforms.data() + first);
+    return true;
 }
 
 StaticEntity::~StaticEntity()
 {
+    // don't leave a dangling pointer behind for physics()
+    CollisionsOff();
 
     if (hModule != nullptr)
     {
-        FreeLibrary(*hModule);
-        delete hModule;
+        FreeLibrary(hModule);
     }
 
     if (texture != nullptr)
@@ -1570,12 +3159,31 @@ StaticEntity::~StaticEntity()
         delete texture;
     }
 
-    EntityType ThisType = STATIC_ENTITY;
-    std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> pushback(this, ThisType);
-    auto it = std::find(AllEntities.begin(), AllEntities.end(), pushback);
+    StaticEntityDrawGrid.remove(this);
+    ComponentRow row = Components.location(component_handle);
+    Archetype<EntityRef>& archetype = Components.archetype(row.archetype);
+    invalidateStaticLayer(archetype.positions[row.row], archetype.sizes[row.row], archetype.renders[row.row]);
+    AllEntities.remove(entity_handle);
+    Components.destroy(component_handle);
+}
+
+void* StaticEntity::operator new(size_t size)
+{
+    // a class derived from StaticEntity doesn't fit the pool's blocks
+    if (size != sizeof(StaticEntity))
+    {
+        return ::operator new(size);
+    }
+    return StaticEntityPool.allocate();
+}
 
-    // If the element was found, remove it
-    if (it != AllEntities.end()) {
-        AllEntities.erase(it);
+void StaticEntity::operator delete(void* memory, size_t size)
+{
+    // sized like operator new was, so a derived object goes back to the heap it came from
+    if (size != sizeof(StaticEntity))
+    {
+        ::operator delete(memory);
+        return;
     }
+    StaticEntityPool.deallocate(memory);
 }
\ No newline at end of file
@@ -3,6 +3,21 @@
 #include "../../dep/SDL2-2.30.5/include/SDL.h"
 
 #include "Texture.h"
+#include "SlotMap.h"
+#include "ObjectPool.h"
+#include "ComponentStore.h"
+#include "SpatialGrid.h"
+#include "StaticBVH.h"
+#include "DynamicAABBTree.h"
+#include "SimdKernels.h"
+#include "SweptAABB.h"
+#include "LevelFormat.h"
+#include "ChunkStreamer.h"
+#include "SpriteBatch.h"
+#include "StaticLayerCache.h"
+#include "Camera.h"
+#include "RenderCommands.h"
+#include "JobThread.h"
 
 #include <iostream>
 #include <chrono>
@@ -34,6 +49,14 @@ enum EntityType : uint8_t
 };
 
 
+// How physics() finds the platforms a player might be touching
+enum BroadphaseMode : uint8_t
+{
+    BROADPHASE_BRUTE_FORCE = 1, // test every player against every platform
+    BROADPHASE_GRID, // only test platforms in the grid cells the player overlaps
+    BROADPHASE_BVH // walk a bounding volume hierarchy over the platforms
+};
+
 typedef Uint8 ColourT;
 
 bool quit_menu = false;
@@ -45,30 +68,143 @@ double roundToSignificantFigures(double num, int n);
 
 SDL_Renderer* renderer = nullptr;
 
-std::vector<std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType>> AllEntities;
+typedef std::pair<std::variant<Entity*, StaticEntity*, Player*>, EntityType> EntityRef;
+
+// Registries, each object keeps the handles it was given so it can take itself out in O(1).
+// Removal moves the last element into the gap, so their order changes as objects are destroyed.
+SlotMap<EntityRef> AllEntities;
 
-std::vector<StaticEntity*> StaticEntityCollisions;
-std::vector<Player*> PlayerCollisions;
-std::vector<Entity*> EntityCollisions;
+SlotMap<StaticEntity*> StaticEntityCollisions;
+SlotMap<Player*> PlayerCollisions;
+SlotMap<Entity*> EntityCollisions;
 
+// In the order the players were made: controller i drives player i and split-screen camera i follows it,
+// so removing a player keeps everyone after it in order. There are only ever a few players.
 std::vector<Player*> AllPlayers;
 
+// The data physics() and draw_screen() work on, one row per Entity/StaticEntity/Player.
+// The classes keep their public fields: every frame the fields of players and entities are copied in
+// before physics runs and the players' are copied back out afterwards. Static entities are only
+// copied when they are created, when their collisions are turned on or off and when changed() is called.
+ComponentStore<EntityRef> Components;
+
+typedef ComponentStore<EntityRef>::Location ComponentRow;
+
+// Rows of the players with collisions on, sorted by x for the player-player sweep, kept between frames
+std::vector<ComponentRow> PlayerSweepOrder;
+
+// Scratch copy of the players' hot physics values, in Components order, used by physics()
+PlayerPhysicsSoA PlayerPhysics;
+
 int SCREEN_X = 1920 / 2;
 int SCREEN_Y = 1080 / 2;
 
 const int max_X = 192000;
 const int max_Y = 108000;
 
-long long cameraX = 0;
-long long cameraY = 0;
-double camera_magnification = 1.00;
+BroadphaseMode broadphase_mode = BROADPHASE_GRID;
+
+// Physics runs at a fixed rate, independent of how fast frames are drawn
+int physics_tick_rate = 60;
+
+// Movement values (velocities, accelerations, jumps) are per 60th of a second; a tick is this many of those
+inline double tick_step()
+{
+    return 60.0 / physics_tick_rate;
+}
+
+// Most physics ticks run for one frame. Time beyond that is dropped so a slow machine
+// slows the game down instead of falling further and further behind.
+const int max_physics_steps_per_frame = 5;
+
+// How far between the previous physics tick (0) and the latest one (1) the current frame is drawn
+double render_alpha = 1.0;
+
+// Set by init_headless(): no window or renderer exists, only physics runs
+bool headless = false;
+
+// Work done by physics(), totals since the engine started. Used for profiling.
+struct PhysicsStats
+{
+    unsigned long long ticks;
+    unsigned long long player_pairs_tested; // player-player pairs the sweep checked for overlap
+    unsigned long long platform_candidates; // platform/entity boxes the broadphase handed to the swept collision solver
+};
+
+PhysicsStats physics_stats = {};
+
+// What the last draw_screen() drew
+struct RenderStats
+{
+    unsigned long long sprites; // objects on screen, queued for drawing
+    unsigned long long culled; // objects skipped because they were off screen, including platforms the draw grid never handed out
+    unsigned long long draw_calls; // SDL draw calls the sprite batch made, one per run of sprites sharing a texture
+    unsigned long long static_tiles; // static layer cache tiles drawn; the platforms in them aren't counted above
+    unsigned long long static_tiles_redrawn; // of those, tiles that had their platforms drawn into them again first
+};
+
+RenderStats render_stats = {};
+
+// Size of one broadphase grid cell in world units
+const int grid_cell_size = 6000;
+
+// Every platform with collisions on, kept up to date by StaticEntity::CollisionsOn/CollisionsOff
+SpatialGrid<StaticEntity> StaticEntityGrid(grid_cell_size);
+
+// Size of one cell of the grid draw_screen() finds platforms with, in world units.
+// A sixteenth of the screen's width at normal zoom; bigger cells made adding and removing platforms slower.
+const int draw_grid_cell_size = 12000;
+
+// Every platform, whether its collisions are on or not, at the box its row in Components is drawn at.
+// Updated whenever a platform's components are written, so draw_screen() only looks at platforms near the screen.
+SpatialGrid<StaticEntity> StaticEntityDrawGrid(draw_grid_cell_size);
+
+// Largest texture offset of any platform. The offsets are added after the camera's magnification,
+// so draw_screen() widens its grid query by this much to catch textures drawn past their platform.
+long long static_draw_margin = 0;
 
+// Whether draw_screen() draws still platforms through the static layer cache, see set_static_layer_cache()
+bool static_layer_caching = true;
 
+// Tree over StaticEntityCollisions, marked dirty by StaticEntity::CollisionsOn/CollisionsOff
+// and rebuilt at most once per physics() call
+StaticBVH<StaticEntity> StaticEntityBVH;
 
-// Global variables for smooth camera movement
-double targetCameraX = 0;
-double targetCameraY = 0;
-double cameraMoveSpeed = 0.01; // Adjust the speed of camera movement
+// Boxes of StaticEntityCollisions in the same order, for the brute force path.
+// Repacked by physics() after StaticEntity::CollisionsOn/CollisionsOff change the list.
+PackedAABBs StaticEntityBounds;
+bool StaticEntityBoundsDirty = true;
+
+// How far an Entity can move before its node in EntityTree has to be reinserted
+const int entity_tree_margin = 1000;
+
+// Every Entity with collisions on, refit by physics() as they move
+DynamicAABBTree<Entity> EntityTree(entity_tree_margin);
+
+// A resident chunk of a streamed world, see enable_world_streaming()
+struct StreamedChunk
+{
+    ChunkCoord coord;
+    bool loaded = false; // false while its file is still being read
+    std::vector<StaticEntity*> platforms;
+    std::vector<StaticEntityDesc> records; // what platforms were created from, platforms[i] from records[i]
+};
+
+// Chunks within stream_radius chunks of the camera, keyed by chunk coordinates
+std::unordered_map<uint64_t, StreamedChunk> WorldChunks;
+int stream_radius = 2;
+
+// The cameras the world is drawn with, one per viewport. update_cameras() moves them once per frame,
+// before anything is drawn; draw code only reads their view().
+std::vector<Camera> Cameras(1);
+
+CameraSettings camera_settings = { 0.15, 1.0, 1.0, 0.6 };
+
+// One camera per player instead of one for everyone, see set_split_screen()
+bool split_screen = false;
+
+// Split-screen has at most this many viewports, more players share the last one
+const size_t max_split_screen_cameras = 4;
 
 // Event handler
 SDL_Event e;
@@ -106,6 +242,16 @@ public:
     long long int x_before;
     long long int y_before;
 
+    // Which sides the player hit something on last tick, pointing away from what was hit:
+    // contact_normal_y = 1 is standing on a platform, -1 is hitting a ceiling,
+    // contact_normal_x = 1 / -1 is a wall on the left / right. 0 when nothing was hit.
+    int contact_normal_x = 0;
+    int contact_normal_y = 0;
+
+    // position at the start of the latest physics tick, drawing interpolates from here to x/y
+    long long int x_previous;
+    long long int y_previous;
+
     double acceleration;
     double velocity;
     double velocity_pp_collision;
@@ -122,6 +268,16 @@ public:
 
     Texture* texture = nullptr;
 
+    // Where it is drawn among the other objects: higher layers over lower ones, from -128 to 127. In a layer,
+    // objects with the same texture are drawn in depth order, from -32768 to 32767, then in the order they were created.
+    int draw_layer = 0;
+    int draw_depth = 0;
+
+    // this player's place in AllEntities, PlayerCollisions and Components
+    SlotHandle entity_handle;
+    SlotHandle collision_handle;
+    SlotHandle component_handle;
+
     void CollisionsOn();
 
     void CollisionsOff();
@@ -139,12 +295,20 @@ public:
 
     ~Player();
 
+    // Players come out of PlayerPool, see reserve_entities()
+    static void* operator new(size_t size);
+    static void operator delete(void* memory, size_t size);
+
+    // position to draw at this frame
+    long long render_x() const;
+    long long render_y() const;
+
     void draw_tex(long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add);
 
     void draw(long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add);
 
 private:
-    HMODULE* hModule = nullptr;
+    HMODULE hModule = nullptr;
 };
 
 
@@ -157,7 +321,7 @@ long long squared_distance(Player* p1, Player* p2);
 class GAME_ENGINE_API Entity
 {
 private:
-    HMODULE* hModule = nullptr;
+    HMODULE hModule = nullptr;
 public:
     // position is bottom-left
     long long int x; // x: 0 to 192,000
@@ -175,19 +339,21 @@ public:
 
     Texture* texture = nullptr;
 
-    void CollisionsOn()
-    {
-        EntityCollisions.push_back(this);
-    }
+    // Where it is drawn among the other objects: higher layers over lower ones, from -128 to 127. In a layer,
+    // objects with the same texture are drawn in depth order, from -32768 to 32767, then in the order they were created.
+    int draw_layer = 0;
+    int draw_depth = 0;
 
-    void CollisionsOff()
-    {
-        auto it = std::find(EntityCollisions.begin(), EntityCollisions.end(), this);
-        if (it != EntityCollisions.end())
-        {
-            EntityCollisions.erase(it);  // This removes the element at 'it'
-        }
-    }
+    int collision_proxy = -1; // node in EntityTree while collisions are on
+
+    // this entity's place in AllEntities, EntityCollisions and Components
+    SlotHandle entity_handle;
+    SlotHandle collision_handle;
+    SlotHandle component_handle;
+
+    void CollisionsOn();
+
+    void CollisionsOff();
 
     Entity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY);
 
@@ -199,6 +365,10 @@ public:
 
     ~Entity();
 
+    // Entities come out of EntityPool, see reserve_entities()
+    static void* operator new(size_t size);
+    static void operator delete(void* memory, size_t size);
+
     void draw_tex(long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add)
     {
         draw_original(true, texture, Colour, x, y, sizeX, sizeY, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
@@ -217,7 +387,7 @@ private:
 class GAME_ENGINE_API StaticEntity
 {
 private:
-    HMODULE* hModule = nullptr;
+    HMODULE hModule = nullptr;
 
 public:
     // position is bottom-left
@@ -236,24 +406,25 @@ public:
 
     Texture* texture = nullptr;
 
+    // Where it is drawn among the other objects: higher layers over lower ones, from -128 to 127. In a layer,
+    // objects with the same texture are drawn in depth order, from -32768 to 32767, then in the order they were created.
+    int draw_layer = 0;
+    int draw_depth = 0;
 
-    void CollisionsOn()
-    {
-        auto it = std::find(StaticEntityCollisions.begin(), StaticEntityCollisions.end(), this);
-        if (it == StaticEntityCollisions.end())
-        {
-            StaticEntityCollisions.push_back(this);
-        }
-    }
+    // this platform's place in AllEntities, StaticEntityCollisions and Components
+    SlotHandle entity_handle;
+    SlotHandle collision_handle;
+    SlotHandle component_handle;
 
-    void CollisionsOff()
-    {
-        auto it = std::find(StaticEntityCollisions.begin(), StaticEntityCollisions.end(), this);
-        if (it != StaticEntityCollisions.end())
-        {
-            StaticEntityCollisions.erase(it);  // This removes the element at 'it'
-        }
-    }
+    void CollisionsOn();
+
+    void CollisionsOff();
+
+    // Call after changing the position, size, texture offsets, Colour, texture, draw_layer or draw_depth.
+    // Platforms are only read when they are made and when their collisions are turned on or off, until
+    // then they are drawn and collide where and how they were; this reads them again and redraws the
+    // static layer cache tiles they were and are in.
+    void changed();
 
     StaticEntity(long long int X_POS, long long int Y_POS, unsigned int SizeX, unsigned int SizeY);
 
@@ -265,6 +436,12 @@ public:
 
     ~StaticEntity();
 
+    // Static entities come out of StaticEntityPool, see reserve_entities()
+    static void* operator new(size_t size);
+    static void operator delete(void* memory, size_t size);
+
+    friend void createStaticEntities(const StaticEntityDesc* descs, size_t count, StaticEntity** out, const std::vector<DecodedImage>* images);
+
     void draw_tex(long long x_in_add, long long y_in_add, long long sizex_in_add, long long sizey_in_add)
     {
         draw_original(true, texture, Colour, x, y, sizeX, sizeY, x_in_add, y_in_add, sizex_in_add, sizey_in_add);
@@ -276,10 +453,160 @@ public:
     }
 
 private:
+    // For create_static_entities(): sets up the fields and texture, but leaves registering to the caller.
+    // With decoded (the desc's image, decoded already) the texture is only uploaded.
+    StaticEntity(const StaticEntityDesc& desc, SDL_Surface* decoded = nullptr);
+};
+
+
+// The simulation state of every player and Entity at one moment, in one flat buffer, for rollback,
+// replays and restarting a round. Holds positions, velocities, accelerations, jump_number and the
+// rest of what physics() reads; not which objects exist or have collisions on, so restore() only
+// works while the objects that were captured are still alive.
+// The buffer starts on a page and players and entities each start on a page of their own, with
+// fixed-size records, so two snapshots of the same match can be diffed and patched page by page.
+class GAME_ENGINE_API WorldSnapshot
+{
+public:
+    static const size_t PAGE_SIZE = 4096;
+
+    WorldSnapshot() = default;
+    ~WorldSnapshot();
+
+    WorldSnapshot(const WorldSnapshot&) = delete;
+    WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+    // Records the current state, reusing the buffer when it is big enough
+    void capture();
+
+    // Puts every captured player and entity back the way it was. Returns false, changing nothing,
+    // if the snapshot is empty or any of them has been destroyed since.
+    bool restore() const;
+
+    // Copies in a snapshot that came from somewhere else (a file, the network). False if it isn't one.
+    bool load(const unsigned char* bytes, size_t byteCount);
+
+    const unsigned char* data() const
+    {
+        return mData;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    size_t pageCount() const
+    {
+        return (mSize + PAGE_SIZE - 1) / PAGE_SIZE;
+    }
+
+    // Lists the pages that differ from base. If the two aren't the same size every page is listed.
+    void diff(const WorldSnapshot& base, std::vector<uint32_t>& changedPages) const;
+
+    // Overwrites these pages with the ones from source, which has to be the same size,
+    // turning a copy of base into current with the pages diff() found
+    void copyPages(const WorldSnapshot& source, const std::vector<uint32_t>& pages);
+
+private:
+    void resize(size_t byteCount);
 
+    unsigned char* mData = nullptr;
+    size_t mSize = 0;
+    size_t mCapacity = 0;
 };
 
 
-void GAME_ENGINE_API init();
+// Creates an Entity, StaticEntity or Player with any of its constructors, from its pool
+template <typename T, typename... Args>
+T* spawn(Args&&... args)
+{
+    static_assert(std::is_same_v<T, Entity> || std::is_same_v<T, StaticEntity> || std::is_same_v<T, Player>,
+        "spawn() only creates engine objects");
+    return new T(std::forward<Args>(args)...);
+}
+
+// Destroys an object made by spawn() (or new), giving its block back to the pool
+template <typename T>
+void despawn(T* object)
+{
+    delete object;
+}
+
+void GAME_ENGINE_API init(BroadphaseMode broadphase = BROADPHASE_GRID);
+
+void GAME_ENGINE_API main_loop();
+
+// Physics ticks per second (60 by default). Movement values stay per 60th of a second, so the game runs
+// at the same speed at any rate; higher rates just take smaller steps.
+void GAME_ENGINE_API set_physics_tick_rate(int ticks_per_second);
+
+// Headless mode, for bots and balance simulations: sets up the engine without SDL, a window or a renderer.
+// Use instead of init(). Only create players and entities with the colour constructors, textures need a renderer.
+void GAME_ENGINE_API init_headless(BroadphaseMode broadphase = BROADPHASE_GRID);
+
+// Runs this many physics ticks as fast as possible
+void GAME_ENGINE_API step(int ticks = 1);
+
+// Runs this many physics ticks, each one taking 1 / physics tick rate seconds of real time
+void GAME_ENGINE_API step_realtime(int ticks = 1);
+
+// Sets a player's input for the following ticks, the way a keyboard or controller would:
+// acceleration is the horizontal input (-160 to 160 for full left/right), jump presses jump once
+void GAME_ENGINE_API inject_input(Player* player, double acceleration, bool jumping);
+
+PhysicsStats GAME_ENGINE_API get_physics_stats();
+
+RenderStats GAME_ENGINE_API get_render_stats();
+
+// Gives every player (up to four) a camera and a part of the window of their own: side by side for two,
+// quarters for three or four. Off, one camera follows all the players over the whole window.
+void GAME_ENGINE_API set_split_screen(bool split);
+
+// Cameras zoom out as the players they follow move apart, down to min_magnification, and back in up to
+// max_magnification as they come together. Equal values fix the zoom; the default is a fixed 1.
+void GAME_ENGINE_API set_camera_zoom(double min_magnification, double max_magnification);
+
+size_t GAME_ENGINE_API get_camera_count();
+
+// Platforms in draw_layer 0 that aren't animated are drawn into tiles of a few hundred pixels that are kept between frames,
+// so a frame draws the tiles instead of every platform. Tiles are drawn again when platforms in them are
+// created or destroyed, and while the camera zooms the platforms are drawn one by one. On by default.
+void GAME_ENGINE_API set_static_layer_cache(bool on);
+
+// The view a camera drew the last frame with, for drawing things of your own over the world
+ViewTransform GAME_ENGINE_API get_camera_view(size_t camera);
+
+// Number of allocations (operator new calls) the engine has made since it started. Only counted
+// when the engine is built with GAME_ENGINE_COUNT_ALLOCATIONS (the Bench configuration), 0 otherwise.
+unsigned long long GAME_ENGINE_API allocation_count();
+
+// Whether this build of the engine counts allocations, see allocation_count()
+bool GAME_ENGINE_API allocation_counting();
+
+// Creates count platforms in one go, for building levels. Storage is reserved up front, every
+// platform is registered in a single pass and the grid takes them all in one batch insert.
+// out receives the count new platforms, in the same order; destroy them with despawn() / delete.
+void GAME_ENGINE_API create_static_entities(const StaticEntityDesc* descs, size_t count, StaticEntity** out);
+
+// Loads a binary level made by levelconv: maps the file into memory and creates its platforms
+// straight from the mapped records with create_static_entities(). The new platforms are appended
+// to platforms and belong to the caller. Returns false (and creates nothing) if the file can't be
+// read or isn't a level this version understands.
+bool GAME_ENGINE_API load_level(const std::string& path, std::vector<StaticEntity*>& platforms);
+
+// Streams a world too big to keep resident. The level is stored as one file per chunk of
+// LEVEL_CHUNK_SIZE world units (levelconv --chunks writes them into directory) and only the chunks
+// within radius chunks of the players' midpoint are loaded. Chunks load on a background thread as the
+// players move, and are written back to their files when they unload if their platforms changed.
+// Streamed platforms belong to the engine, don't delete them.
+void GAME_ENGINE_API enable_world_streaming(const std::string& directory, int radius = 2);
+
+// Unloads every chunk, saving the ones that changed, and stops the loading thread.
+// main_loop() calls this when it ends; headless programs have to call it before they exit.
+void GAME_ENGINE_API disable_world_streaming();
 
-void GAME_ENGINE_API main_loop();
\ No newline at end of file
+// Grows the object pools, registries, component rows and collision trees so this many of each (and a texture
+// for every one of them) can exist at once without allocating. Call before a match so spawning players and
+// entities stays off the heap. Platforms can still allocate a cell of the platform grids they are the first in.
+void GAME_ENGINE_API reserve_entities(size_t entities, size_t static_entities, size_t players);
\ No newline at end of file
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+
+#include "SimdKernels.h"
+
+// Uniform grid used as a broadphase for collisions, unbounded in every direction.
+// Every item is stored in each cell its bounding box overlaps. The box an item was
+// inserted with is remembered, so it can be removed even if the object has moved since.
+// Each cell also keeps its items' boxes packed, so a query tests a whole cell with overlapAABBs().
+// Cells live in a hash map keyed by cell coordinates and only exist while something is in them,
+// so memory follows the objects, not the size of the world.
+template <typename T>
+class SpatialGrid
+{
+public:
+    SpatialGrid(long long cellSize)
+    {
+        reset(cellSize);
+    }
+
+    // Change the cell size, throwing away everything in the grid
+    void reset(long long cellSize)
+    {
+        mCellSize = cellSize;
+        mCells.clear();
+        mItems.clear();
+        mLookup.clear();
+        mStamp = 0;
+    }
+
+    void clear()
+    {
+        mCells.clear();
+        mItems.clear();
+        mLookup.clear();
+    }
+
+    // Makes room for this many items in all. Cells are still made as items first land in them.
+    void reserve(size_t items)
+    {
+        mItems.reserve(items);
+        mLookup.reserve(items);
+    }
+
+    bool contains(T* item) const
+    {
+        return mLookup.find(item) != mLookup.end();
+    }
+
+    // position is bottom-left, same as the entities
+    void insert(T* item, long long x, long long y, long long sizeX, long long sizeY)
+    {
+        if (contains(item))
+        {
+            return;
+        }
+
+        Item newItem;
+        newItem.ptr = item;
+        newItem.minX = x;
+        newItem.minY = y;
+        newItem.maxX = x + sizeX;
+        newItem.maxY = y + sizeY;
+        newItem.range = cellRange(newItem.minX, newItem.minY, newItem.maxX, newItem.maxY);
+        newItem.stamp = mStamp;
+
+        uint32_t index = uint32_t(mItems.size());
+        mItems.push_back(newItem);
+        mLookup[item] = index;
+
+        for (int cy = newItem.range.y0; cy <= newItem.range.y1; ++cy)
+        {
+            for (int cx = newItem.range.x0; cx <= newItem.range.x1; ++cx)
+            {
+                Cell& cell = mCells[cellKey(cx, cy)];
+                cell.items.push_back(index);
+                cell.bounds.push_back(newItem.minX, newItem.minY, newItem.maxX, newItem.maxY);
+            }
+        }
+    }
+
+    // Inserts many objects at once, reading their boxes from x, y, sizeX and sizeY.
+    // Counts how much each cell gains first, so every cell's arrays grow at most once.
+    void insert(const std::vector<T*>& objects)
+    {
+        size_t first = mItems.size();
+        mItems.reserve(first + objects.size());
+        mLookup.reserve(first + objects.size());
+        for (T* object : objects)
+        {
+            if (contains(object))
+            {
+                continue;
+            }
+
+            Item newItem;
+            newItem.ptr = object;
+            newItem.minX = object->x;
+            newItem.minY = object->y;
+            newItem.maxX = object->x + object->sizeX;
+            newItem.maxY = object->y + object->sizeY;
+            newItem.range = cellRange(newItem.minX, newItem.minY, newItem.maxX, newItem.maxY);
+            newItem.stamp = mStamp;
+
+            mLookup[object] = uint32_t(mItems.size());
+            mItems.push_back(newItem);
+        }
+
+        for (size_t index = first; index < mItems.size(); ++index)
+        {
+            const CellRange& range = mItems[index].range;
+            for (int cy = range.y0; cy <= range.y1; ++cy)
+            {
+                for (int cx = range.x0; cx <= range.x1; ++cx)
+                {
+                    ++mCells[cellKey(cx, cy)].pending;
+                }
+            }
+        }
+
+        for (size_t index = first; index < mItems.size(); ++index)
+        {
+            const Item& item = mItems[index];
+            for (int cy = item.range.y0; cy <= item.range.y1; ++cy)
+            {
+                for (int cx = item.range.x0; cx <= item.range.x1; ++cx)
+                {
+                    Cell& cell = mCells[cellKey(cx, cy)];
+                    if (cell.pending > 0)
+                    {
+                        cell.items.reserve(cell.items.size() + cell.pending);
+                        cell.bounds.reserve(cell.items.size() + cell.pending);
+                        cell.pending = 0;
+                    }
+                    cell.items.push_back(uint32_t(index));
+                    cell.bounds.push_back(item.minX, item.minY, item.maxX, item.maxY);
+                }
+            }
+        }
+    }
+
+    void remove(T* item)
+    {
+        auto it = mLookup.find(item);
+        if (it == mLookup.end())
+        {
+            return;
+        }
+
+        uint32_t index = it->second;
+        mLookup.erase(it);
+        unlinkFromCells(index, mItems[index].range);
+
+        // Swap the last item into the hole so the item array stays dense
+        uint32_t last = uint32_t(mItems.size() - 1);
+        if (index != last)
+        {
+            mItems[index] = mItems[last];
+            relinkInCells(last, index, mItems[index].range);
+            mLookup[mItems[index].ptr] = index;
+        }
+        mItems.pop_back();
+    }
+
+    // Appends every item whose box overlaps the given box (edges touching counts) to out.
+    // Each item is reported once, however many of the cells it shares with the query.
+    void query(long long minX, long long minY, long long maxX, long long maxY, std::vector<T*>& out)
+    {
+        if (mItems.empty())
+        {
+            return;
+        }
+
+        if (++mStamp == 0)
+        {
+            // the stamp wrapped around, so old stamps could match again
+            for (auto& item : mItems)
+            {
+                item.stamp = 0;
+            }
+            mStamp = 1;
+        }
+
+        CellRange range = cellRange(minX, minY, maxX, maxY);
+        for (int cy = range.y0; cy <= range.y1; ++cy)
+        {
+            for (int cx = range.x0; cx <= range.x1; ++cx)
+            {
+                auto found = mCells.find(cellKey(cx, cy));
+                if (found == mCells.end())
+                {
+                    continue;
+                }
+
+                const Cell& cell = found->second;
+                overlapAABBs(minX, minY, maxX, maxY, cell.bounds, mMask);
+
+                for (size_t word = 0; word < mMask.size(); ++word)
+                {
+                    for (uint64_t bits = mMask[word]; bits != 0; bits &= bits - 1)
+                    {
+                        Item& item = mItems[cell.items[word * 64 + std::countr_zero(bits)]];
+                        if (item.stamp != mStamp)
+                        {
+                            item.stamp = mStamp;
+                            out.push_back(item.ptr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return mItems.size();
+    }
+
+private:
+    struct CellRange
+    {
+        int x0, y0, x1, y1;
+    };
+
+    struct Cell
+    {
+        std::vector<uint32_t> items;
+        PackedAABBs bounds; // same order as items
+        uint32_t pending = 0; // items the batch insert() is about to add
+    };
+
+    struct Item
+    {
+        T* ptr;
+        long long minX, minY, maxX, maxY;
+        CellRange range;
+        uint32_t stamp;
+    };
+
+    // Rounds down, so negative coordinates get their own cells instead of sharing cell 0
+    int cellOf(long long position) const
+    {
+        long long cell = position / mCellSize;
+        if (position % mCellSize < 0)
+        {
+            --cell;
+        }
+        return int(cell);
+    }
+
+    CellRange cellRange(long long minX, long long minY, long long maxX, long long maxY) const
+    {
+        return { cellOf(minX), cellOf(minY), cellOf(maxX), cellOf(maxY) };
+    }
+
+    static uint64_t cellKey(int cx, int cy)
+    {
+        return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+    }
+
+    void unlinkFromCells(uint32_t index, const CellRange& range)
+    {
+        for (int cy = range.y0; cy <= range.y1; ++cy)
+        {
+            for (int cx = range.x0; cx <= range.x1; ++cx)
+            {
+                auto found = mCells.find(cellKey(cx, cy));
+                if (found == mCells.end())
+                {
+                    continue;
+                }
+
+                Cell& cell = found->second;
+                auto it = std::find(cell.items.begin(), cell.items.end(), index);
+                if (it != cell.items.end())
+                {
+                    cell.bounds.swapRemove(it - cell.items.begin());
+                    *it = cell.items.back();
+                    cell.items.pop_back();
+                }
+
+                // drop empty cells, so parts of the world nothing is in any more cost nothing
+                if (cell.items.empty())
+                {
+                    mCells.erase(found);
+                }
+            }
+        }
+    }
+
+    void relinkInCells(uint32_t from, uint32_t to, const CellRange& range)
+    {
+        for (int cy = range.y0; cy <= range.y1; ++cy)
+        {
+            for (int cx = range.x0; cx <= range.x1; ++cx)
+            {
+                Cell& cell = mCells.find(cellKey(cx, cy))->second;
+                std::replace(cell.items.begin(), cell.items.end(), from, to);
+            }
+        }
+    }
+
+    long long mCellSize;
+    std::unordered_map<uint64_t, Cell> mCells;
+    std::vector<Item> mItems;
+    std::unordered_map<T*, uint32_t> mLookup;
+    uint32_t mStamp;
+    std::vector<uint64_t> mMask; // scratch for query()
+};
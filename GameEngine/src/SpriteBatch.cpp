@@ -0,0 +1,193 @@
+#include "SpriteBatch.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <cstring>
+
+void SpriteBatch::addRect(uint32_t layer, uint64_t depth, const SDL_Rect& dst, SDL_Color colour)
+{
+    Quad quad = {};
+    quad.layer = layer;
+    quad.depth = depth;
+    quad.texture = nullptr;
+    quad.dst = dst;
+    quad.colour = colour;
+    mQuads.push_back(quad);
+}
+
+void SpriteBatch::addSprite(uint32_t layer, uint64_t depth, SDL_Texture* texture, int textureWidth, int textureHeight, const SDL_Rect& src,
+    const SDL_Rect& dst, SDL_RendererFlip flip)
+{
+    Quad quad = {};
+    quad.layer = layer;
+    quad.depth = depth;
+    quad.texture = texture;
+    quad.src = src;
+    quad.dst = dst;
+    quad.colour = { 255, 255, 255, 255 };
+    quad.flip = flip;
+
+    quad.u0 = float(src.x) / float(textureWidth);
+    quad.v0 = float(src.y) / float(textureHeight);
+    quad.u1 = float(src.x + src.w) / float(textureWidth);
+    quad.v1 = float(src.y + src.h) / float(textureHeight);
+    if (flip & SDL_FLIP_HORIZONTAL)
+    {
+        std::swap(quad.u0, quad.u1);
+    }
+    if (flip & SDL_FLIP_VERTICAL)
+    {
+        std::swap(quad.v0, quad.v1);
+    }
+    mQuads.push_back(quad);
+
+    // sprites mostly come a texture at a time, flush() takes the repeats out
+    if (mTextures.empty() || mTextures.back() != texture)
+    {
+        mTextures.push_back(texture);
+    }
+}
+
+void SpriteBatch::flush(SDL_Renderer* renderer)
+{
+    // A texture's part of the key is its place among this frame's textures by address, so any two textures
+    // are in the same order in every batch. Colour rectangles (nullptr) come first.
+    mTextures.push_back(nullptr);
+    std::sort(mTextures.begin(), mTextures.end(), std::less<SDL_Texture*>());
+    mTextures.erase(std::unique(mTextures.begin(), mTextures.end()), mTextures.end());
+
+    const uint64_t maxTexture = (uint64_t(1) << TEXTURE_BITS) - 1;
+    const uint64_t maxDepth = (uint64_t(1) << DEPTH_BITS) - 1;
+    mKeys.resize(mQuads.size());
+    SDL_Texture* lastTexture = nullptr;
+    uint64_t textureKey = 0;
+    for (size_t i = 0; i < mQuads.size(); ++i)
+    {
+        const Quad& quad = mQuads[i];
+        if (quad.texture != lastTexture)
+        {
+            auto found = std::lower_bound(mTextures.begin(), mTextures.end(), quad.texture, std::less<SDL_Texture*>());
+            textureKey = std::min(uint64_t(found - mTextures.begin()), maxTexture);
+            lastTexture = quad.texture;
+        }
+        mKeys[i].key = (uint64_t(quad.layer) << (TEXTURE_BITS + DEPTH_BITS)) | (textureKey << DEPTH_BITS) | std::min(quad.depth, maxDepth);
+        mKeys[i].quad = uint32_t(i);
+    }
+    sortKeys();
+
+    mSpritesDrawn = mQuads.size();
+    mDrawCalls = 0;
+
+    size_t begin = 0;
+    while (begin < mKeys.size())
+    {
+        const Quad& first = mQuads[mKeys[begin].quad];
+        size_t end = begin + 1;
+        while (end < mKeys.size() && mQuads[mKeys[end].quad].layer == first.layer && mQuads[mKeys[end].quad].texture == first.texture)
+        {
+            ++end;
+        }
+        drawRun(renderer, begin, end);
+        begin = end;
+    }
+
+    mQuads.clear();
+    mTextures.clear();
+}
+
+void SpriteBatch::sortKeys()
+{
+    if (mKeys.size() < 2)
+    {
+        return;
+    }
+
+    // How many keys have each value of each byte, all eight counted in one pass
+    size_t counts[8][256];
+    std::memset(counts, 0, sizeof(counts));
+    for (const SortKey& key : mKeys)
+    {
+        for (int byte = 0; byte < 8; ++byte)
+        {
+            ++counts[byte][(key.key >> (byte * 8)) & 0xFF];
+        }
+    }
+
+    mSortScratch.resize(mKeys.size());
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        // Most of the key is the same for a whole frame: the layer's high bits, the texture's, most of the depth
+        size_t* count = counts[byte];
+        if (count[(mKeys[0].key >> (byte * 8)) & 0xFF] == mKeys.size())
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int value = 0; value < 256; ++value)
+        {
+            size_t keys = count[value];
+            count[value] = offset;
+            offset += keys;
+        }
+        for (const SortKey& key : mKeys)
+        {
+            mSortScratch[count[(key.key >> (byte * 8)) & 0xFF]++] = key;
+        }
+        mKeys.swap(mSortScratch);
+    }
+}
+
+void SpriteBatch::drawRun(SDL_Renderer* renderer, size_t begin, size_t end)
+{
+    size_t count = end - begin;
+
+    // Two triangles per quad: top-left, top-right, bottom-right and bottom-right, bottom-left, top-left.
+    // The indices are the same every frame, they only grow when a run is longer than any before.
+    for (size_t quad = mIndices.size() / 6; quad < count; ++quad)
+    {
+        int first = int(quad * 4);
+        mIndices.insert(mIndices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+    }
+
+    mVertices.resize(count * 4);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Quad& quad = mQuads[mKeys[begin + i].quad];
+        float left = float(quad.dst.x);
+        float top = float(quad.dst.y);
+        float right = float(quad.dst.x + quad.dst.w);
+        float bottom = float(quad.dst.y + quad.dst.h);
+
+        SDL_Vertex* vertex = &mVertices[i * 4];
+        vertex[0] = { { left, top }, quad.colour, { quad.u0, quad.v0 } };
+        vertex[1] = { { right, top }, quad.colour, { quad.u1, quad.v0 } };
+        vertex[2] = { { right, bottom }, quad.colour, { quad.u1, quad.v1 } };
+        vertex[3] = { { left, bottom }, quad.colour, { quad.u0, quad.v1 } };
+    }
+
+    SDL_Texture* texture = mQuads[mKeys[begin].quad].texture;
+    ++mDrawCalls;
+    if (SDL_RenderGeometry(renderer, texture, mVertices.data(), int(count * 4), mIndices.data(), int(count * 6)) == 0)
+    {
+        return;
+    }
+
+    // Geometry isn't supported by this renderer, draw the quads one at a time instead
+    --mDrawCalls;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const Quad& quad = mQuads[mKeys[i].quad];
+        if (texture == nullptr)
+        {
+            SDL_SetRenderDrawColor(renderer, quad.colour.r, quad.colour.g, quad.colour.b, quad.colour.a);
+            SDL_RenderFillRect(renderer, &quad.dst);
+        }
+        else
+        {
+            SDL_RenderCopyEx(renderer, texture, &quad.src, &quad.dst, 0, nullptr, quad.flip);
+        }
+        ++mDrawCalls;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../../dep/SDL2-2.30.5/include/SDL.h"
+#include <vector>
+#include <cstdint>
+
+// Collects the sprites of a frame and draws them with as few draw calls as possible.
+// flush() gives every quad a 64-bit key, layer then texture then depth from the top bit down, radix sorts
+// the keys (keeping the order quads were added in for equal keys), then draws every run of quads that share
+// a layer and texture with one SDL_RenderGeometry call. Plain colour rectangles have no texture, so they are one run too.
+// If the renderer can't draw geometry the run falls back to one SDL_RenderCopyEx/SDL_RenderFillRect per quad.
+// Sprites in different layers are drawn in layer order; in the same layer, sprites with the same texture are
+// drawn in depth order, while sprites with different textures that overlap may be drawn in any order.
+class SpriteBatch
+{
+public:
+    // How the key's bits are shared out. Layers go up to 2^LAYER_BITS - 1 and depths to 2^DEPTH_BITS - 1.
+    // A frame with more than 2^TEXTURE_BITS textures in a layer still draws correctly, with a few more draw calls.
+    static const int LAYER_BITS = 10;
+    static const int TEXTURE_BITS = 12;
+    static const int DEPTH_BITS = 64 - LAYER_BITS - TEXTURE_BITS;
+
+    // A plain colour rectangle, like SDL_RenderFillRect with that draw colour
+    void addRect(uint32_t layer, uint64_t depth, const SDL_Rect& dst, SDL_Color colour);
+
+    // The src part of texture (textureWidth x textureHeight pixels) stretched over dst, like SDL_RenderCopyEx without rotation
+    void addSprite(uint32_t layer, uint64_t depth, SDL_Texture* texture, int textureWidth, int textureHeight, const SDL_Rect& src,
+        const SDL_Rect& dst, SDL_RendererFlip flip);
+
+    // Draws everything added since the last flush() and empties the batch
+    void flush(SDL_Renderer* renderer);
+
+    // Empties the batch without drawing
+    void clear()
+    {
+        mQuads.clear();
+        mTextures.clear();
+    }
+
+    // Sprites drawn and draw calls made by the last flush()
+    size_t spritesDrawn() const
+    {
+        return mSpritesDrawn;
+    }
+
+    size_t drawCalls() const
+    {
+        return mDrawCalls;
+    }
+
+private:
+    struct Quad
+    {
+        uint32_t layer;
+        uint64_t depth;
+        SDL_Texture* texture; // nullptr for a colour rectangle
+        SDL_Rect src;
+        SDL_Rect dst;
+        SDL_Color colour;
+        SDL_RendererFlip flip;
+        float u0, v0, u1, v1; // texture coordinates of the top-left and bottom-right corner, flip applied
+    };
+
+    // A quad's place in the draw order
+    struct SortKey
+    {
+        uint64_t key;
+        uint32_t quad; // index in mQuads
+    };
+
+    // Stable sort of mKeys by key, a byte at a time from the lowest; bytes every key has the same are skipped
+    void sortKeys();
+
+    // Draws the quads of mKeys[begin] to mKeys[end - 1], which share a texture
+    void drawRun(SDL_Renderer* renderer, size_t begin, size_t end);
+
+    std::vector<Quad> mQuads;
+    std::vector<SDL_Texture*> mTextures; // the textures added since the last flush(), some more than once
+    std::vector<SortKey> mKeys;
+    std::vector<SortKey> mSortScratch;
+    std::vector<SDL_Vertex> mVertices;
+    std::vector<int> mIndices;
+    size_t mSpritesDrawn = 0;
+    size_t mDrawCalls = 0;
+};
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+
+#include "SimdKernels.h"
+
+// Bounding volume hierarchy over objects that (almost) never move, like platforms.
+// It is rebuilt from scratch rather than updated, so callers mark it dirty when the set of
+// objects changes and rebuild it once before the next query. Leaves are scanned with overlapAABBs().
+template <typename T>
+class StaticBVH
+{
+public:
+    // Largest number of objects kept in a leaf
+    static const int LEAF_SIZE = 4;
+
+    void markDirty()
+    {
+        mDirty = true;
+    }
+
+    bool dirty() const
+    {
+        return mDirty;
+    }
+
+    // Build the tree over the objects' boxes (x, y, sizeX, sizeY, position is bottom-left)
+    void build(const std::vector<T*>& objects)
+    {
+        mNodes.clear();
+        mItems.clear();
+        mItems.reserve(objects.size());
+        for (T* object : objects)
+        {
+            Item item;
+            item.ptr = object;
+            item.minX = object->x;
+            item.minY = object->y;
+            item.maxX = object->x + object->sizeX;
+            item.maxY = object->y + object->sizeY;
+            mItems.push_back(item);
+        }
+
+        if (!mItems.empty())
+        {
+            mNodes.reserve(2 * (mItems.size() / LEAF_SIZE + 1));
+            buildNode(0, uint32_t(mItems.size()));
+        }
+
+        // building reorders mItems, so pack the boxes afterwards
+        mBounds.clear();
+        mBounds.reserve(mItems.size());
+        for (const Item& item : mItems)
+        {
+            mBounds.push_back(item.minX, item.minY, item.maxX, item.maxY);
+        }
+        mDirty = false;
+    }
+
+    // Appends every object whose box overlaps the given box (edges touching counts) to out
+    void query(long long minX, long long minY, long long maxX, long long maxY, std::vector<T*>& out) const
+    {
+        if (mNodes.empty())
+        {
+            return;
+        }
+
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            uint32_t index = stack[--top];
+            const Node& node = mNodes[index];
+            if (node.minX > maxX || node.maxX < minX || node.minY > maxY || node.maxY < minY)
+            {
+                continue;
+            }
+
+            if (node.count > 0)
+            {
+                uint64_t bits = overlapAABBs(minX, minY, maxX, maxY, mBounds, node.first, node.count);
+                for (; bits != 0; bits &= bits - 1)
+                {
+                    out.push_back(mItems[node.first + std::countr_zero(bits)].ptr);
+                }
+            }
+            else
+            {
+                // the left child always directly follows its parent
+                stack[top++] = node.first;
+                stack[top++] = index + 1;
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return mItems.size();
+    }
+
+private:
+    struct Item
+    {
+        T* ptr;
+        long long minX, minY, maxX, maxY;
+    };
+
+    // Leaves have count > 0 and hold mItems[first, first + count).
+    // Inner nodes have count == 0, the left child at the next index and the right child at first.
+    struct Node
+    {
+        long long minX, minY, maxX, maxY;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    uint32_t buildNode(uint32_t begin, uint32_t end)
+    {
+        uint32_t index = uint32_t(mNodes.size());
+        mNodes.push_back(Node());
+
+        Node node;
+        node.minX = mItems[begin].minX;
+        node.minY = mItems[begin].minY;
+        node.maxX = mItems[begin].maxX;
+        node.maxY = mItems[begin].maxY;
+        for (uint32_t i = begin + 1; i < end; ++i)
+        {
+            node.minX = std::min(node.minX, mItems[i].minX);
+            node.minY = std::min(node.minY, mItems[i].minY);
+            node.maxX = std::max(node.maxX, mItems[i].maxX);
+            node.maxY = std::max(node.maxY, mItems[i].maxY);
+        }
+
+        if (end - begin <= LEAF_SIZE)
+        {
+            node.first = begin;
+            node.count = end - begin;
+            mNodes[index] = node;
+            return index;
+        }
+
+        // Split at the median centre along the longest axis, so the tree stays balanced
+        bool splitX = (node.maxX - node.minX) >= (node.maxY - node.minY);
+        uint32_t mid = begin + (end - begin) / 2;
+        std::nth_element(mItems.begin() + begin, mItems.begin() + mid, mItems.begin() + end,
+            [splitX](const Item& a, const Item& b)
+            {
+                if (splitX)
+                {
+                    return a.minX + a.maxX < b.minX + b.maxX;
+                }
+                return a.minY + a.maxY < b.minY + b.maxY;
+            });
+
+        buildNode(begin, mid);
+        node.first = buildNode(mid, end);
+        node.count = 0;
+        mNodes[index] = node;
+        return index;
+    }
+
+    std::vector<Node> mNodes;
+    std::vector<Item> mItems;
+    PackedAABBs mBounds; // same order as mItems
+    bool mDirty = true;
+};
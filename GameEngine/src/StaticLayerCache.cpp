@@ -0,0 +1,231 @@
+#include "StaticLayerCache.h"
+
+#include <cmath>
+
+void StaticLayerCache::beginFrame()
+{
+    ++mFrame;
+    mTilesQueued = 0;
+    mTilesDrawn = 0;
+}
+
+bool StaticLayerCache::queue(SDL_Renderer* renderer, const ScreenTransform& transform, const SDL_Rect& viewport, SpriteBatch& batch,
+    uint32_t layer, const DrawTile& drawTile)
+{
+    if (renderer != mRenderer)
+    {
+        clear();
+        mRenderer = renderer;
+    }
+    if (!SDL_RenderTargetSupported(renderer))
+    {
+        return false;
+    }
+
+    // A new scale has to last into the next frame before the tiles are drawn again for it, while the camera zooms they'd
+    // be thrown away every frame. Tiles drawn at nearly the scale can stand in until then.
+    if (!mHasScale || !sameScale(transform, mScale, 0))
+    {
+        if (mPendingFrame == 0 || !sameScale(transform, mPendingScale, 0))
+        {
+            mPendingScale = transform;
+            mPendingFrame = mFrame;
+        }
+
+        if (mPendingFrame < mFrame)
+        {
+            mScale = mPendingScale;
+            mHasScale = true;
+            for (auto& tile : mTiles)
+            {
+                tile.second.dirty = true;
+            }
+        }
+        else if (!mHasScale || !sameScale(transform, mScale, 1e-4))
+        {
+            return false;
+        }
+    }
+
+    // Tile (0, 0) starts where the world's origin is drawn
+    int originX = int(std::floor(transform.translateX + 0.5));
+    int originY = int(std::floor(transform.translateY + 0.5));
+    int firstX = int(std::floor(double(viewport.x - originX) / TILE_SIZE));
+    int firstY = int(std::floor(double(viewport.y - originY) / TILE_SIZE));
+    int lastX = int(std::floor(double(viewport.x + viewport.w - 1 - originX) / TILE_SIZE));
+    int lastY = int(std::floor(double(viewport.y + viewport.h - 1 - originY) / TILE_SIZE));
+    if (size_t(lastX - firstX + 1) * size_t(lastY - firstY + 1) > MAX_TILES)
+    {
+        return false;
+    }
+
+    // Every tile has to be there before any is queued, so a viewport is either all tiles or none
+    for (int ty = firstY; ty <= lastY; ++ty)
+    {
+        for (int tx = firstX; tx <= lastX; ++tx)
+        {
+            auto found = mTiles.find(tileKey(tx, ty));
+            if (found != mTiles.end())
+            {
+                found->second.lastUsed = mFrame;
+                continue;
+            }
+
+            SDL_Texture* texture = takeTexture(renderer);
+            if (texture == nullptr)
+            {
+                return false;
+            }
+            mTiles[tileKey(tx, ty)] = { texture, true, mFrame };
+        }
+    }
+
+    for (int ty = firstY; ty <= lastY; ++ty)
+    {
+        for (int tx = firstX; tx <= lastX; ++tx)
+        {
+            Tile& tile = mTiles[tileKey(tx, ty)];
+            if (tile.dirty)
+            {
+                this->drawTile(renderer, tx, ty, tile, drawTile);
+            }
+
+            SDL_Rect src = { 0, 0, TILE_SIZE, TILE_SIZE };
+            SDL_Rect dst = { originX + tx * TILE_SIZE, originY + ty * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+            batch.addSprite(layer, 0, tile.texture, TILE_SIZE, TILE_SIZE, src, dst, SDL_FLIP_NONE);
+            ++mTilesQueued;
+        }
+    }
+    return true;
+}
+
+void StaticLayerCache::invalidate(double x, double y, double w, double h, double ox, double oy, double ow, double oh)
+{
+    if (!mHasScale || mTiles.empty())
+    {
+        return;
+    }
+
+    // Where the rectangle is drawn with the world's origin at pixel 0, a pixel wider each way for rounding
+    ScreenTransform scale = mScale;
+    scale.translateX = 0;
+    scale.translateY = 0;
+    PixelRect rect = transformRect(scale, x, y, w, h, ox, oy, ow, oh);
+    int firstX = int(std::floor(double(rect.x - 1) / TILE_SIZE));
+    int firstY = int(std::floor(double(rect.y - 1) / TILE_SIZE));
+    int lastX = int(std::floor(double(rect.x + rect.w + 1) / TILE_SIZE));
+    int lastY = int(std::floor(double(rect.y + rect.h + 1) / TILE_SIZE));
+
+    // A rectangle over more tiles than there are is quicker to check tile by tile
+    if (double(lastX - firstX + 1) * double(lastY - firstY + 1) > double(mTiles.size()))
+    {
+        for (auto& tile : mTiles)
+        {
+            int tx = int(int32_t(tile.first >> 32));
+            int ty = int(int32_t(tile.first & 0xFFFFFFFF));
+            if (tx >= firstX && tx <= lastX && ty >= firstY && ty <= lastY)
+            {
+                tile.second.dirty = true;
+            }
+        }
+        return;
+    }
+
+    for (int ty = firstY; ty <= lastY; ++ty)
+    {
+        for (int tx = firstX; tx <= lastX; ++tx)
+        {
+            auto found = mTiles.find(tileKey(tx, ty));
+            if (found != mTiles.end())
+            {
+                found->second.dirty = true;
+            }
+        }
+    }
+}
+
+void StaticLayerCache::clear()
+{
+    for (auto& tile : mTiles)
+    {
+        SDL_DestroyTexture(tile.second.texture);
+    }
+    mTiles.clear();
+    mHasScale = false;
+    mPendingFrame = 0;
+}
+
+bool StaticLayerCache::sameScale(const ScreenTransform& a, const ScreenTransform& b, double tolerance)
+{
+    auto near = [tolerance](double x, double y)
+        {
+            return std::abs(x - y) <= std::abs(y) * tolerance;
+        };
+    return near(a.scaleX, b.scaleX) && near(a.scaleY, b.scaleY) && near(a.offsetScaleX, b.offsetScaleX) && near(a.offsetScaleY, b.offsetScaleY);
+}
+
+SDL_Texture* StaticLayerCache::takeTexture(SDL_Renderer* renderer)
+{
+    if (mTiles.size() < MAX_TILES)
+    {
+        SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, TILE_SIZE, TILE_SIZE);
+        if (texture == nullptr)
+        {
+            return nullptr;
+        }
+
+        // The tile holds colour already multiplied by alpha, drawing it with normal blending would multiply again
+        static const SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+            SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+            SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+        mPremultiplied = SDL_SetTextureBlendMode(texture, premultiplied) == 0;
+        if (!mPremultiplied)
+        {
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
+        return texture;
+    }
+
+    // the least recently used tile that isn't on screen this frame
+    auto oldest = mTiles.end();
+    for (auto tile = mTiles.begin(); tile != mTiles.end(); ++tile)
+    {
+        if (tile->second.lastUsed < mFrame && (oldest == mTiles.end() || tile->second.lastUsed < oldest->second.lastUsed))
+        {
+            oldest = tile;
+        }
+    }
+    if (oldest == mTiles.end())
+    {
+        return nullptr;
+    }
+
+    SDL_Texture* texture = oldest->second.texture;
+    mTiles.erase(oldest);
+    return texture;
+}
+
+void StaticLayerCache::drawTile(SDL_Renderer* renderer, int tx, int ty, Tile& tile, const DrawTile& draw)
+{
+    SDL_Texture* target = SDL_GetRenderTarget(renderer);
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+    SDL_SetRenderTarget(renderer, tile.texture);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+
+    // Pixel (0, 0) of the tile is pixel (tx * TILE_SIZE, ty * TILE_SIZE) from the world's origin.
+    // y goes down in pixels and up in the world.
+    ScreenTransform transform = mScale;
+    transform.translateX = -double(tx) * TILE_SIZE;
+    transform.translateY = -double(ty) * TILE_SIZE;
+    draw(transform,
+        double(tx) * TILE_SIZE / mScale.scaleX, -double(ty + 1) * TILE_SIZE / mScale.scaleY,
+        double(tx + 1) * TILE_SIZE / mScale.scaleX, -double(ty) * TILE_SIZE / mScale.scaleY);
+
+    SDL_SetRenderTarget(renderer, target);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+    tile.dirty = false;
+    ++mTilesDrawn;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../../dep/SDL2-2.30.5/include/SDL.h"
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+#include "SimdKernels.h"
+#include "SpriteBatch.h"
+
+// Keeps the platforms drawn into render target tiles, so a frame draws a few tile textures instead of
+// every platform on screen. Tiles are TILE_SIZE pixels square and laid over the world at the camera's
+// scale: moving the camera only changes where they are drawn, while zooming needs them drawn again,
+// so tiles are only drawn for a scale once it has lasted more than a frame. Tiles are drawn when first
+// seen, drawn again after invalidate() touches them, and the least recently used go when there are
+// MAX_TILES of them.
+// Tiles hold premultiplied colour. Renderers without custom blend modes (the software renderer) can
+// only draw them with normal blending, which would darken half-transparent pixels; on those only
+// opaque platforms go into tiles (see premultiplied()).
+class StaticLayerCache
+{
+public:
+    static const int TILE_SIZE = 512;
+    static const size_t MAX_TILES = 64;
+
+    // Draws the platforms in a box of the world (minX, minY, maxX, maxY) through transform, into the
+    // tile that is the current render target
+    typedef std::function<void(const ScreenTransform& transform, double minX, double minY, double maxX, double maxY)> DrawTile;
+
+    // Call once at the start of every frame, before queue()
+    void beginFrame();
+
+    // Queues the tiles covering viewport for transform into batch at layer, drawing the missing ones with drawTile first.
+    // Has to be called before the viewport's clip rect is set. False if the layer can't be cached this
+    // frame (the scale is changing, or the renderer has no render targets); nothing is queued then.
+    bool queue(SDL_Renderer* renderer, const ScreenTransform& transform, const SDL_Rect& viewport, SpriteBatch& batch,
+        uint32_t layer, const DrawTile& drawTile);
+
+    // Tiles showing any of a rectangle are drawn again next time they are used. The rectangle is given
+    // the way transformRect() takes it: a box of the world plus texture offsets.
+    void invalidate(double x, double y, double w, double h, double ox = 0, double oy = 0, double ow = 0, double oh = 0);
+
+    // Destroys every tile, before the renderer goes. Tiles left when the renderer is destroyed go with it.
+    void clear();
+
+    // False if the renderer can't draw tiles with premultiplied blending: then only platforms with no
+    // partly transparent pixels may be drawn into tiles, the rest have to be drawn directly to match.
+    // Known once queue() has made a tile.
+    bool premultiplied() const
+    {
+        return mPremultiplied;
+    }
+
+    // Tiles queued and tiles drawn since beginFrame()
+    size_t tilesQueued() const
+    {
+        return mTilesQueued;
+    }
+
+    size_t tilesDrawn() const
+    {
+        return mTilesDrawn;
+    }
+
+private:
+    struct Tile
+    {
+        SDL_Texture* texture;
+        bool dirty;
+        uint64_t lastUsed; // frame the tile was last queued in
+    };
+
+    // Whether two transforms scale the world the same, give or take a share of tolerance. A zoom easing towards its
+    // target creeps for a while, tiles a 10,000th off are well under a pixel off across the screen.
+    static bool sameScale(const ScreenTransform& a, const ScreenTransform& b, double tolerance);
+
+    static uint64_t tileKey(int tx, int ty)
+    {
+        return (uint64_t(uint32_t(tx)) << 32) | uint32_t(ty);
+    }
+
+    // A tile texture for a new tile: a new one, or the least recently used tile's. nullptr if there is none to take.
+    SDL_Texture* takeTexture(SDL_Renderer* renderer);
+
+    void drawTile(SDL_Renderer* renderer, int tx, int ty, Tile& tile, const DrawTile& draw);
+
+    SDL_Renderer* mRenderer = nullptr;
+    ScreenTransform mScale = {}; // the scale the tiles are drawn at, only the scale fields are used
+    ScreenTransform mPendingScale = {}; // a new scale, adopted if it is still the same next frame
+    uint64_t mPendingFrame = 0;
+    bool mHasScale = false;
+    bool mPremultiplied = true;
+    std::unordered_map<uint64_t, Tile> mTiles;
+    uint64_t mFrame = 1;
+    size_t mTilesQueued = 0;
+    size_t mTilesDrawn = 0;
+};
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "SweptAABB.h"
+
+#include <climits>
+#include <algorithm>
+#include <cmath>
+
+// The loops below are written as min/max reductions over the packed arrays rather than
+// if/else chains, so they compile to conditional moves and don't depend on branch prediction.
+
+// When a point moving from start by move is inside [lo, hi] on one axis, as fractions of the move:
+// the obstacle widened by the box's size (lo already has it taken off), so the box is just its corner.
+// Moving onto an edge counts, a box that isn't moving on the axis has to be strictly inside.
+static inline void slab(long long start, long long move, double inverse, long long lo, long long hi, double& entry, double& exit)
+{
+    const double near = double((move > 0 ? lo : hi) - start) * inverse;
+    const double far = double((move > 0 ? hi : lo) - start) * inverse;
+    const bool inside = start > lo && start < hi;
+    entry = move != 0 ? near : (inside ? -HUGE_VAL : HUGE_VAL);
+    exit = move != 0 ? far : HUGE_VAL;
+}
+
+// Moves the box along x only, from x0 to x1 at height y, stopping at the first obstacle it's level with
+static void sweepX(long long x0, long long x1, long long y, long long sizeX, long long sizeY, const PackedAABBs& obstacles, SweepHit& hit)
+{
+    const size_t count = obstacles.size();
+    const long long* minX = obstacles.minX.data();
+    const long long* minY = obstacles.minY.data();
+    const long long* maxX = obstacles.maxX.data();
+    const long long* maxY = obstacles.maxY.data();
+
+    hit.x = x1;
+    if (x1 > x0)
+    {
+        long long best = LLONG_MAX;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bool hits = y < maxY[i] && y + sizeY > minY[i] && minX[i] >= x0 + sizeX && minX[i] < x1 + sizeX;
+            best = hits && minX[i] < best ? minX[i] : best;
+        }
+        if (best != LLONG_MAX)
+        {
+            hit.x = best - sizeX;
+            hit.normalX = -1;
+        }
+    }
+    else if (x1 < x0)
+    {
+        long long best = LLONG_MIN;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bool hits = y < maxY[i] && y + sizeY > minY[i] && maxX[i] <= x0 && maxX[i] > x1;
+            best = hits && maxX[i] > best ? maxX[i] : best;
+        }
+        if (best != LLONG_MIN)
+        {
+            hit.x = best;
+            hit.normalX = 1;
+        }
+    }
+}
+
+// Moves the box along y only, from y0 to y1 at x, stopping at the first obstacle it's under or over
+static void sweepY(long long y0, long long y1, long long x, long long sizeX, long long sizeY, const PackedAABBs& obstacles, SweepHit& hit)
+{
+    const size_t count = obstacles.size();
+    const long long* minX = obstacles.minX.data();
+    const long long* minY = obstacles.minY.data();
+    const long long* maxX = obstacles.maxX.data();
+    const long long* maxY = obstacles.maxY.data();
+
+    hit.y = y1;
+    if (y1 < y0)
+    {
+        // falling: the highest top that was at or below the box and is now above its bottom
+        long long best = LLONG_MIN;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bool hits = x < maxX[i] && x + sizeX > minX[i] && maxY[i] <= y0 && maxY[i] > y1;
+            best = hits && maxY[i] > best ? maxY[i] : best;
+        }
+        if (best != LLONG_MIN)
+        {
+            hit.y = best;
+            hit.normalY = 1;
+        }
+    }
+    else if (y1 > y0)
+    {
+        // rising: the lowest bottom that was at or above the box and is now below its top
+        long long best = LLONG_MAX;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bool hits = x < maxX[i] && x + sizeX > minX[i] && minY[i] >= y0 + sizeY && minY[i] < y1 + sizeY;
+            best = hits && minY[i] < best ? minY[i] : best;
+        }
+        if (best != LLONG_MAX)
+        {
+            hit.y = best - sizeY;
+            hit.normalY = -1;
+        }
+    }
+}
+
+SweepHit sweepAABB(long long x0, long long y0, long long x1, long long y1, long long sizeX, long long sizeY, const PackedAABBs& obstacles)
+{
+    SweepHit hit;
+    hit.normalX = 0;
+    hit.normalY = 0;
+
+    const size_t count = obstacles.size();
+    const long long* minX = obstacles.minX.data();
+    const long long* minY = obstacles.minY.data();
+    const long long* maxX = obstacles.maxX.data();
+    const long long* maxY = obstacles.maxY.data();
+
+    // Depenetration: a box that starts inside an obstacle (it moved into the box, or the box was
+    // put there) would be skipped by the sweeps below and let the box fall through it. Push the
+    // start out along the axis it's least deep in, and the end with it, so the sweep then finds
+    // the obstacle's edge. One pass in order, which is enough for the few obstacles a box touches.
+    int pushedX = 0;
+    int pushedY = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!(x0 < maxX[i] && x0 + sizeX > minX[i] && y0 < maxY[i] && y0 + sizeY > minY[i]))
+        {
+            continue;
+        }
+
+        // ties go up, so a box sunk into a floor corner stands on it rather than sliding off
+        long long up = maxY[i] - y0;
+        long long down = y0 + sizeY - minY[i];
+        long long right = maxX[i] - x0;
+        long long left = x0 + sizeX - minX[i];
+        long long least = std::min(std::min(up, down), std::min(right, left));
+        if (least == up)
+        {
+            y0 += up;
+            y1 += up;
+            pushedY = 1;
+        }
+        else if (least == down)
+        {
+            y0 -= down;
+            y1 -= down;
+            pushedY = -1;
+        }
+        else if (least == right)
+        {
+            x0 += right;
+            x1 += right;
+            pushedX = 1;
+        }
+        else
+        {
+            x0 -= left;
+            x1 -= left;
+            pushedX = -1;
+        }
+    }
+    // Time of impact: the slab method against every obstacle over the whole move, keeping the
+    // earliest entry in [0, 1]. An obstacle is entered on the axis it's entered on last; when both
+    // axes enter at once (a corner) it counts as vertical, so a box lands on a corner rather than
+    // catching on its side.
+    const long long moveX = x1 - x0;
+    const long long moveY = y1 - y0;
+    const double inverseX = moveX != 0 ? 1.0 / double(moveX) : 0.0;
+    const double inverseY = moveY != 0 ? 1.0 / double(moveY) : 0.0;
+
+    double first = 2.0; // past the end of the move: nothing hit
+    size_t firstIndex = 0;
+    bool firstVertical = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        double entryX, exitX, entryY, exitY;
+        slab(x0, moveX, inverseX, minX[i] - sizeX, maxX[i], entryX, exitX);
+        slab(y0, moveY, inverseY, minY[i] - sizeY, maxY[i], entryY, exitY);
+
+        bool vertical = entryY >= entryX;
+        double entry = vertical ? entryY : entryX;
+        double exit = exitX < exitY ? exitX : exitY;
+        bool hits = entry >= 0.0 && entry <= 1.0 && entry <= exit;
+        bool earlier = hits && (entry < first || (entry == first && vertical && !firstVertical));
+
+        first = earlier ? entry : first;
+        firstIndex = earlier ? i : firstIndex;
+        firstVertical = earlier ? vertical : firstVertical;
+    }
+
+    // Stop on the axis that hit, at the obstacle's edge, then move the rest of the way along the
+    // other one from where the box touched, so a box that lands still slides along the floor and
+    // one that hits a wall still falls down it. The point of touching is rounded back towards the
+    // start, so it's never inside anything.
+    if (first > 1.0)
+    {
+        hit.x = x1;
+        hit.y = y1;
+    }
+    else if (firstVertical)
+    {
+        hit.y = moveY < 0 ? maxY[firstIndex] : minY[firstIndex] - sizeY;
+        hit.normalY = moveY < 0 ? 1 : -1;
+        sweepX(x0 + (long long)(first * double(moveX)), x1, hit.y, sizeX, sizeY, obstacles, hit);
+    }
+    else
+    {
+        hit.x = moveX > 0 ? minX[firstIndex] - sizeX : maxX[firstIndex];
+        hit.normalX = moveX > 0 ? -1 : 1;
+        sweepY(y0 + (long long)(first * double(moveY)), y1, hit.x, sizeX, sizeY, obstacles, hit);
+    }
+
+    // an axis the box was pushed out along is still touching what it was pushed out of
+    hit.normalX = hit.normalX != 0 ? hit.normalX : pushedX;
+    hit.normalY = hit.normalY != 0 ? hit.normalY : pushedY;
+
+    return hit;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SimdKernels.h"
+
+// Where a moving box ended up after sweepAABB(), and which sides it hit.
+// The normal points out of the obstacle that was hit: normalY = 1 means the box landed on top of
+// something, -1 that it hit a ceiling, normalX = 1 / -1 that it hit something on its left / right.
+// An axis that hit nothing has a normal of 0 and keeps the position the box was moving to.
+struct SweepHit
+{
+    long long x;
+    long long y;
+    int normalX;
+    int normalY;
+};
+
+// Moves a box of size sizeX * sizeY (position is bottom-left) from (x0, y0) to (x1, y1), stopping it
+// at the first obstacle it would pass into. The time of impact is found over the whole move (the slab
+// method), so fast or diagonal boxes can't tunnel through thin obstacles or corners. The box stops on
+// the axis it hit and moves the rest of the way along the other one, so a box that lands on a floor
+// still slides along it and one that hits a wall still falls. A box that starts inside an obstacle is
+// first pushed out of it along the shallowest axis (the end moves with it), and that axis reports the contact.
+SweepHit sweepAABB(long long x0, long long y0, long long x1, long long y1, long long sizeX, long long sizeY, const PackedAABBs& obstacles);
\ No newline at end of file
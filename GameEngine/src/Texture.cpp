@@ -1,7 +1,19 @@
 #include "Texture.h"
+#include "ObjectPool.h"
 #include <iostream>
+#include <cstdint>
 #include <Windows.h>
 
+static ObjectPool<Texture> texturePool;
+
+// Images small enough to share a texture, one copy of each however many textures load it
+static TextureAtlas textureAtlas;
+
+// The atlas key of a resource, the same for every load of it from the same module
+static std::string resourceKey(HMODULE hModule, int resourceID) {
+    return "resource:" + std::to_string(reinterpret_cast<uintptr_t>(hModule)) + ":" + std::to_string(resourceID);
+}
+
 // Constructor
 Texture::Texture()
     : mTexture(nullptr), mFrameGap(0), mWidth(0), mHeight(0),
@@ -11,6 +23,7 @@ Texture::Texture()
     mFlip(SDL_FLIP_NONE)
 {
     animated = false;
+    mRegion = { nullptr, 0, 0, { 0, 0, 0, 0 }, -1, false };
 }
 
 void Texture::setFlip(SDL_RendererFlip flip) {
@@ -19,36 +32,91 @@ void Texture::setFlip(SDL_RendererFlip flip) {
 
 // Destructor
 Texture::~Texture() {
-    if (mTexture != nullptr) {
+    unload();
+}
+
+void Texture::unload() {
+    if (mRegion.entry >= 0) {
+        textureAtlas.release(mRegion);
+    }
+    else if (mTexture != nullptr) {
         SDL_DestroyTexture(mTexture);
-        mTexture = nullptr;
     }
+    mTexture = nullptr;
+    mRegion = { nullptr, 0, 0, { 0, 0, 0, 0 }, -1, false };
+    mWidth = 0;
+    mHeight = 0;
 }
 
-// Helper function to create texture from SDL_Surface
-bool Texture::createTextureFromSurface(SDL_Renderer* renderer, SDL_Surface* surface) {
-    // Create texture from surface pixels
-    mTexture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (mTexture == nullptr) {
-        std::cerr << "Unable to create texture from surface! SDL Error: " << SDL_GetError() << std::endl;
+void Texture::releaseAtlas(SDL_Renderer* renderer) {
+    textureAtlas.dropRenderer(renderer);
+}
+
+void* Texture::operator new(size_t size) {
+    // a class derived from Texture doesn't fit the pool's blocks
+    if (size != sizeof(Texture)) {
+        return ::operator new(size);
+    }
+    return texturePool.allocate();
+}
+
+void Texture::operator delete(void* memory, size_t size) {
+    // sized like operator new was, so a derived object goes back to the heap it came from
+    if (size != sizeof(Texture)) {
+        ::operator delete(memory);
+        return;
+    }
+    texturePool.deallocate(memory);
+}
+
+void Texture::reservePool(size_t count) {
+    texturePool.reserve(count);
+}
+
+bool Texture::loadFromAtlas(SDL_Renderer* renderer, const std::string& key) {
+    if (!textureAtlas.acquire(renderer, key, mRegion)) {
         return false;
     }
 
+    mTexture = mRegion.page;
+    mWidth = mRegion.rect.w;
+    mHeight = mRegion.rect.h;
+    return true;
+}
+
+// Helper function to create texture from SDL_Surface
+bool Texture::createTextureFromSurface(SDL_Renderer* renderer, SDL_Surface* surface, const std::string& key) {
     // Get image dimensions
     mWidth = surface->w;
     mHeight = surface->h;
 
+    if (textureAtlas.add(renderer, key, surface, mRegion)) {
+        mTexture = mRegion.page;
+        return true;
+    }
+
+    // Too big for the atlas, create texture from surface pixels
+    mTexture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (mTexture == nullptr) {
+        std::cerr << "Unable to create texture from surface! SDL Error: " << SDL_GetError() << std::endl;
+        mWidth = 0;
+        mHeight = 0;
+        return false;
+    }
+    mRegion = { mTexture, mWidth, mHeight, { 0, 0, mWidth, mHeight }, -1, partlyTransparent(surface) };
+
     return true;
 }
 
 // Load texture from file
 bool Texture::loadFromFile(SDL_Renderer* renderer, const std::string& path) {
     // Free any pre-existing texture
-    if (mTexture != nullptr) {
-        SDL_DestroyTexture(mTexture);
-        mTexture = nullptr;
-        mWidth = 0;
-        mHeight = 0;
+    unload();
+
+    // Images already loaded are shared, not loaded again
+    std::string key = "file:" + path;
+    if (loadFromAtlas(renderer, key)) {
+        return true;
     }
 
     // Load image at specified path
@@ -59,7 +127,7 @@ bool Texture::loadFromFile(SDL_Renderer* renderer, const std::string& path) {
     }
 
     // Create texture from surface pixels
-    bool success = createTextureFromSurface(renderer, loadedSurface);
+    bool success = createTextureFromSurface(renderer, loadedSurface, key);
 
     // Free old loaded surface
     SDL_FreeSurface(loadedSurface);
@@ -70,45 +138,21 @@ bool Texture::loadFromFile(SDL_Renderer* renderer, const std::string& path) {
 // Load texture from resource
 bool Texture::loadFromResource(SDL_Renderer* renderer, int resourceID) {
     // Free any pre-existing texture
-    if (mTexture != nullptr) {
-        SDL_DestroyTexture(mTexture);
-        mTexture = nullptr;
-        mWidth = 0;
-        mHeight = 0;
-    }
-
-    // Load resource
-    HRSRC hRes = FindResource(NULL, MAKEINTRESOURCE(resourceID), RT_RCDATA); // Use RT_RCDATA for raw data
-    if (hRes == NULL) {
-        std::cerr << "Failed to find resource with ID: " << resourceID << std::endl;
-        return false;
-    }
-
-    HGLOBAL hResLoad = LoadResource(NULL, hRes);
-    if (hResLoad == NULL) {
-        std::cerr << "Failed to load resource with ID: " << resourceID << std::endl;
-        return false;
-    }
-
-    void* pResData = LockResource(hResLoad);
-    DWORD resSize = SizeofResource(NULL, hRes);
+    unload();
 
-    // Create SDL_RWops from resource data
-    SDL_RWops* rw = SDL_RWFromMem(pResData, resSize);
-    if (rw == nullptr) {
-        std::cerr << "Unable to create SDL_RWops from resource data! SDL Error: " << SDL_GetError() << std::endl;
-        return false;
+    std::string key = resourceKey(NULL, resourceID);
+    if (loadFromAtlas(renderer, key)) {
+        return true;
     }
 
-    // Load PNG surface from SDL_RWops
-    SDL_Surface* loadedSurface = IMG_Load_RW(rw, 1); // 1 for auto-close
+    // Load PNG surface from resource
+    SDL_Surface* loadedSurface = decodeResource(NULL, resourceID);
     if (loadedSurface == nullptr) {
-        std::cerr << "Unable to create SDL_Surface from PNG resource data! SDL_image Error: " << IMG_GetError() << std::endl;
         return false;
     }
 
     // Create texture from surface pixels
-    bool success = createTextureFromSurface(renderer, loadedSurface);
+    bool success = createTextureFromSurface(renderer, loadedSurface, key);
 
     // Free old loaded surface
     SDL_FreeSurface(loadedSurface);
@@ -158,6 +202,10 @@ void Texture::updateAnimation() {
     }
 }
 
+bool Texture::isAnimated() const {
+    return animated;
+}
+
 
 // Render texture at given point
 void Texture::render(SDL_Renderer* renderer, int x, int y, int width, int height)
@@ -165,7 +213,7 @@ void Texture::render(SDL_Renderer* renderer, int x, int y, int width, int height
     if (!animated)
     {
         SDL_Rect renderQuad = { x, y, width, height };
-        SDL_RenderCopyEx(renderer, mTexture, nullptr, &renderQuad, 0, nullptr, mFlip);
+        SDL_RenderCopyEx(renderer, mTexture, &mRegion.rect, &renderQuad, 0, nullptr, mFlip);
     }
     else
     {
@@ -175,6 +223,20 @@ void Texture::render(SDL_Renderer* renderer, int x, int y, int width, int height
 }
 
 void Texture::renderFrame(SDL_Renderer* renderer, int x, int y, int width, int height) {
+    SDL_Rect srcRect;
+    if (!frameRect(srcRect)) {
+        std::cerr << "Source rectangle is out of bounds." << std::endl;
+        return;
+    }
+
+    // Set the destination rectangle to the specified width and height
+    SDL_Rect dstRect = { x, y, width, height };
+
+    // Render the current frame of the animation
+    SDL_RenderCopyEx(renderer, mTexture, &srcRect, &dstRect, 0, nullptr, mFlip);
+}
+
+bool Texture::frameRect(SDL_Rect& srcRect) const {
     // Calculate the number of frames per row
     int framesPerRow = (mWidth - mXOffset - mXEndOffset + mFrameGap) / (mFrameWidth + mFrameGap);
 
@@ -188,58 +250,108 @@ void Texture::renderFrame(SDL_Renderer* renderer, int x, int y, int width, int h
 
     // Ensure the source rectangle is within the bounds of the texture
     if (srcX < mXOffset || srcY < mYOffset || srcX + mFrameWidth > mWidth - mXEndOffset || srcY + mFrameHeight > mHeight - mYEndOffset) {
-        std::cerr << "Source rectangle is out of bounds." << std::endl;
-        return;
+        return false;
     }
 
-    SDL_Rect srcRect = { srcX, srcY, mFrameWidth, mFrameHeight };
+    // Frames are found in the image, which can be anywhere in an atlas page
+    srcRect = { mRegion.rect.x + srcX, mRegion.rect.y + srcY, mFrameWidth, mFrameHeight };
+    return true;
+}
 
-    // Set the destination rectangle to the specified width and height
-    SDL_Rect dstRect = { x, y, width, height };
+SDL_Texture* Texture::getSDLTexture() const {
+    return mTexture;
+}
 
-    // Render the current frame of the animation
-    SDL_RenderCopyEx(renderer, mTexture, &srcRect, &dstRect, 0, nullptr, mFlip);
+int Texture::getSDLTextureWidth() const {
+    return mRegion.pageWidth;
+}
+
+int Texture::getSDLTextureHeight() const {
+    return mRegion.pageHeight;
+}
+
+bool Texture::getSourceRect(SDL_Rect& srcRect) {
+    if (!animated) {
+        srcRect = mRegion.rect;
+        return true;
+    }
+
+    updateAnimation();
+    return frameRect(srcRect);
+}
+
+SDL_RendererFlip Texture::getFlip() const {
+    return mFlip;
+}
+
+bool Texture::isTranslucent() const {
+    return mRegion.translucent;
 }
 
 // Load texture from resource within a DLL
 bool Texture::loadFromResourceDLL(SDL_Renderer* renderer, HMODULE hModule, int resourceID) 
 {
-    if (mTexture != nullptr) {
-        SDL_DestroyTexture(mTexture);
-        mTexture = nullptr;
-        mWidth = 0;
-        mHeight = 0;
+    unload();
+
+    std::string key = resourceKey(hModule, resourceID);
+    if (loadFromAtlas(renderer, key)) {
+        return true;
+    }
+
+    SDL_Surface* loadedSurface = decodeResource(hModule, resourceID);
+    if (loadedSurface == nullptr) {
+        return false;
+    }
+
+    bool success = createTextureFromSurface(renderer, loadedSurface, key);
+    SDL_FreeSurface(loadedSurface);
+
+    return success;
+}
+
+bool Texture::loadFromResourceSurface(SDL_Renderer* renderer, HMODULE hModule, int resourceID, SDL_Surface* surface)
+{
+    unload();
+
+    std::string key = resourceKey(hModule, resourceID);
+    if (loadFromAtlas(renderer, key)) {
+        return true;
+    }
+
+    if (surface == nullptr) {
+        return false; // decodeResource() already said why
     }
 
+    return createTextureFromSurface(renderer, surface, key);
+}
+
+SDL_Surface* Texture::decodeResource(HMODULE hModule, int resourceID) {
     HRSRC hRes = FindResource(hModule, MAKEINTRESOURCE(resourceID), RT_RCDATA); // Use RT_RCDATA for raw data
     if (hRes == NULL) {
         std::cerr << "Failed to find resource with ID: " << resourceID << std::endl;
-        return false;
+        return nullptr;
     }
 
     HGLOBAL hResLoad = LoadResource(hModule, hRes);
     if (hResLoad == NULL) {
         std::cerr << "Failed to load resource with ID: " << resourceID << std::endl;
-        return false;
+        return nullptr;
     }
 
     void* pResData = LockResource(hResLoad);
     DWORD resSize = SizeofResource(hModule, hRes);
 
+    // Create SDL_RWops from resource data
     SDL_RWops* rw = SDL_RWFromMem(pResData, resSize);
     if (rw == nullptr) {
         std::cerr << "Unable to create SDL_RWops from resource data! SDL Error: " << SDL_GetError() << std::endl;
-        return false;
+        return nullptr;
     }
 
+    // Load PNG surface from SDL_RWops
     SDL_Surface* loadedSurface = IMG_Load_RW(rw, 1); // 1 for auto-close
     if (loadedSurface == nullptr) {
         std::cerr << "Unable to create SDL_Surface from PNG resource data! SDL_image Error: " << IMG_GetError() << std::endl;
-        return false;
     }
-
-    bool success = createTextureFromSurface(renderer, loadedSurface);
-    SDL_FreeSurface(loadedSurface);
-
-    return success;
+    return loadedSurface;
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <string>
 #include <Windows.h>
 
+#include "TextureAtlas.h"
+
 class __declspec(dllexport) Texture 
 {
 public:
@@ -12,6 +14,13 @@ public:
     Texture();
     ~Texture();
 
+    // Textures come out of a fixed-block pool, so creating one for a new entity doesn't hit the heap
+    static void* operator new(size_t size);
+    static void operator delete(void* memory, size_t size);
+
+    // Grow the pool so this many textures can exist at once without allocating
+    static void reservePool(size_t count);
+
     // Load texture from file
     bool loadFromFile(SDL_Renderer* renderer, const std::string& path);
 
@@ -29,6 +38,7 @@ public:
     void setAnimationFrames(int numFrames, int frameWidth, int frameHeight, int frameTime, int frameGap, int xOffset, int yOffset, int xEndOffset, int yEndOffset);
 
     void updateAnimation();
+    bool isAnimated() const;
     void renderFrame(SDL_Renderer* renderer, int x, int y, int additionalWidth, int additionalHeight);
 
     // Set texture flip
@@ -36,16 +46,54 @@ public:
 
     bool loadFromResourceDLL(SDL_Renderer* renderer, HMODULE hModule, int resourceID);
 
+    // Like loadFromResourceDLL, with the image already decoded by decodeResource(). Only uploads
+    // it (or takes it from the atlas); surface stays the caller's.
+    bool loadFromResourceSurface(SDL_Renderer* renderer, HMODULE hModule, int resourceID, SDL_Surface* surface);
+
+    // Decodes a PNG resource of hModule (NULL for our own) into a new surface the caller frees,
+    // nullptr if it fails. Doesn't touch a renderer, so it can run on a loading thread.
+    static SDL_Surface* decodeResource(HMODULE hModule, int resourceID);
+
+    // For drawing without render(), e.g. batched: the SDL texture, nullptr if nothing loaded.
+    // Small images share an atlas page with other images, so this can be bigger than getWidth() x getHeight().
+    SDL_Texture* getSDLTexture() const;
+    int getSDLTextureWidth() const;
+    int getSDLTextureHeight() const;
+
+    // The part of the SDL texture to draw this frame, advancing the animation the way render() does.
+    // False if the animation frame is outside the image.
+    bool getSourceRect(SDL_Rect& srcRect);
+
+    // Destroys the atlas pages of renderer, call before destroying it
+    static void releaseAtlas(SDL_Renderer* renderer);
+
+    SDL_RendererFlip getFlip() const;
+
+    // Whether some pixels of the image are partly transparent
+    bool isTranslucent() const;
+
 private:
-    // The actual hardware texture
+    // The actual hardware texture, an atlas page or one of our own
     SDL_Texture* mTexture;
 
     // Image dimensions
     int mWidth;
     int mHeight;
 
-    // Helper function to create texture from SDL_Surface
-    bool createTextureFromSurface(SDL_Renderer* renderer, SDL_Surface* surface);
+    // Where the image is in mTexture, the whole of it if mTexture isn't an atlas page
+    AtlasRegion mRegion;
+
+    // Takes the image loaded under key before from the atlas, false if there isn't one
+    bool loadFromAtlas(SDL_Renderer* renderer, const std::string& key);
+
+    // Helper function to create texture from SDL_Surface, in the atlas under key if it fits there
+    bool createTextureFromSurface(SDL_Renderer* renderer, SDL_Surface* surface, const std::string& key);
+
+    // Frees the texture or our share of the atlas page
+    void unload();
+
+    // Source rectangle of the current animation frame, false if it is out of bounds
+    bool frameRect(SDL_Rect& srcRect) const;
 
     // Animation properties
     bool animated;
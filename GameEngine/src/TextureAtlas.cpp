@@ -0,0 +1,319 @@
+#include "TextureAtlas.h"
+
+#include <iostream>
+#include <algorithm>
+#include <climits>
+
+bool partlyTransparent(SDL_Surface* surface)
+{
+    if (surface->format->Amask == 0)
+    {
+        return false;
+    }
+
+    // 32 bit pixels are read as they are, anything else is converted first
+    if (surface->format->BytesPerPixel != 4)
+    {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (converted == nullptr)
+        {
+            return true; // can't tell, so don't count on it being opaque
+        }
+        bool translucent = partlyTransparent(converted);
+        SDL_FreeSurface(converted);
+        return translucent;
+    }
+
+    const Uint32 mask = surface->format->Amask;
+    const Uint8 shift = surface->format->Ashift;
+    bool translucent = false;
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h && !translucent; ++y)
+    {
+        const Uint32* row = (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < surface->w; ++x)
+        {
+            Uint32 alpha = (row[x] & mask) >> shift;
+            translucent |= alpha != 0 && alpha != 255;
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return translucent;
+}
+
+bool TextureAtlas::acquire(SDL_Renderer* renderer, const std::string& key, AtlasRegion& region)
+{
+    auto found = mKeys.find(key);
+    if (found == mKeys.end())
+    {
+        return false;
+    }
+
+    Entry& entry = mEntries[found->second];
+    const Page& page = mPages[entry.page];
+    if (page.renderer != renderer)
+    {
+        return false;
+    }
+
+    ++entry.users;
+    region = { page.texture, page.width, page.height, entry.rect, found->second, entry.translucent };
+    return true;
+}
+
+bool TextureAtlas::add(SDL_Renderer* renderer, const std::string& key, SDL_Surface* surface, AtlasRegion& region)
+{
+    if (renderer == nullptr || surface->w > MAX_IMAGE_SIZE || surface->h > MAX_IMAGE_SIZE || mKeys.count(key) != 0)
+    {
+        return false;
+    }
+
+    // The image with its border, converted to the pages' format. A new surface starts out transparent.
+    SDL_Surface* padded = SDL_CreateRGBSurfaceWithFormat(0, surface->w + 2, surface->h + 2, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (padded == nullptr)
+    {
+        return false;
+    }
+    SDL_BlendMode blendMode;
+    SDL_GetSurfaceBlendMode(surface, &blendMode);
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_Rect inside = { 1, 1, surface->w, surface->h };
+    bool copied = SDL_BlitSurface(surface, nullptr, padded, &inside) == 0;
+    SDL_SetSurfaceBlendMode(surface, blendMode);
+
+    // The first page with room, or a new one
+    int pageIndex = -1;
+    int x = 0;
+    int y = 0;
+    for (size_t i = 0; i < mPages.size() && pageIndex < 0 && copied; ++i)
+    {
+        if (mPages[i].texture != nullptr && mPages[i].renderer == renderer && pack(mPages[i], padded->w, padded->h, x, y))
+        {
+            pageIndex = int(i);
+        }
+    }
+    if (pageIndex < 0 && copied)
+    {
+        pageIndex = newPage(renderer);
+        if (pageIndex >= 0 && !pack(mPages[pageIndex], padded->w, padded->h, x, y))
+        {
+            SDL_DestroyTexture(mPages[pageIndex].texture);
+            mPages[pageIndex].texture = nullptr;
+            pageIndex = -1;
+        }
+    }
+
+    SDL_Rect target = { x, y, padded->w, padded->h };
+    bool uploaded = pageIndex >= 0 && SDL_UpdateTexture(mPages[pageIndex].texture, &target, padded->pixels, padded->pitch) == 0;
+    bool translucent = uploaded && partlyTransparent(padded);
+    SDL_FreeSurface(padded);
+    if (!uploaded)
+    {
+        // a page made for this image and nothing else isn't worth keeping
+        if (pageIndex >= 0 && mPages[pageIndex].images == 0)
+        {
+            SDL_DestroyTexture(mPages[pageIndex].texture);
+            mPages[pageIndex].texture = nullptr;
+        }
+        return false;
+    }
+
+    int entryIndex;
+    if (mFreeEntries.empty())
+    {
+        entryIndex = int(mEntries.size());
+        mEntries.emplace_back();
+    }
+    else
+    {
+        entryIndex = mFreeEntries.back();
+        mFreeEntries.pop_back();
+    }
+
+    Page& page = mPages[pageIndex];
+    ++page.images;
+    Entry& entry = mEntries[entryIndex];
+    entry.key = key;
+    entry.page = pageIndex;
+    entry.rect = { x + 1, y + 1, surface->w, surface->h };
+    entry.translucent = translucent;
+    entry.users = 1;
+    mKeys[key] = entryIndex;
+
+    region = { page.texture, page.width, page.height, entry.rect, entryIndex, translucent };
+    return true;
+}
+
+void TextureAtlas::release(const AtlasRegion& region)
+{
+    Entry& entry = mEntries[region.entry];
+    if (--entry.users > 0)
+    {
+        return;
+    }
+
+    if (entry.page >= 0)
+    {
+        mKeys.erase(entry.key);
+        Page& page = mPages[entry.page];
+        if (--page.images == 0)
+        {
+            SDL_DestroyTexture(page.texture);
+            page.texture = nullptr;
+        }
+    }
+    entry.key.clear();
+    mFreeEntries.push_back(region.entry);
+}
+
+void TextureAtlas::dropRenderer(SDL_Renderer* renderer)
+{
+    for (size_t i = 0; i < mPages.size(); ++i)
+    {
+        Page& page = mPages[i];
+        if (page.texture == nullptr || page.renderer != renderer)
+        {
+            continue;
+        }
+        SDL_DestroyTexture(page.texture);
+        page.texture = nullptr;
+        page.images = 0;
+
+        for (Entry& entry : mEntries)
+        {
+            if (entry.users > 0 && entry.page == int(i))
+            {
+                mKeys.erase(entry.key);
+                entry.page = -1;
+            }
+        }
+    }
+}
+
+size_t TextureAtlas::pageCount() const
+{
+    return size_t(std::count_if(mPages.begin(), mPages.end(), [](const Page& page) { return page.texture != nullptr; }));
+}
+
+bool TextureAtlas::pack(Page& page, int width, int height, int& x, int& y)
+{
+    // Bottom-left: the spot where the box's top edge ends up lowest, the narrowest step on a tie
+    size_t best = page.skyline.size();
+    int bestTop = INT_MAX;
+    int bestWidth = INT_MAX;
+    for (size_t i = 0; i < page.skyline.size(); ++i)
+    {
+        int top = fitAt(page, i, width, height);
+        if (top < 0)
+        {
+            continue;
+        }
+        if (top + height < bestTop || (top + height == bestTop && page.skyline[i].width < bestWidth))
+        {
+            best = i;
+            bestTop = top + height;
+            bestWidth = page.skyline[i].width;
+        }
+    }
+    if (best == page.skyline.size())
+    {
+        return false;
+    }
+
+    x = page.skyline[best].x;
+    y = bestTop - height;
+
+    // The box becomes a new step, the steps it covers shrink or go
+    page.skyline.insert(page.skyline.begin() + best, { x, bestTop, width });
+    size_t next = best + 1;
+    while (next < page.skyline.size() && page.skyline[next].x < x + width)
+    {
+        SkylineNode& node = page.skyline[next];
+        int covered = x + width - node.x;
+        if (covered < node.width)
+        {
+            node.x += covered;
+            node.width -= covered;
+            break;
+        }
+        page.skyline.erase(page.skyline.begin() + next);
+    }
+
+    // Neighbouring steps at the same height are one step
+    for (size_t i = 0; i + 1 < page.skyline.size();)
+    {
+        if (page.skyline[i].y == page.skyline[i + 1].y)
+        {
+            page.skyline[i].width += page.skyline[i + 1].width;
+            page.skyline.erase(page.skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return true;
+}
+
+int TextureAtlas::fitAt(const Page& page, size_t index, int width, int height)
+{
+    if (page.skyline[index].x + width > page.width)
+    {
+        return -1;
+    }
+
+    // the box rests on the highest step under it
+    int top = 0;
+    int widthLeft = width;
+    for (size_t i = index; widthLeft > 0; ++i)
+    {
+        top = std::max(top, page.skyline[i].y);
+        if (top + height > page.height)
+        {
+            return -1;
+        }
+        widthLeft -= page.skyline[i].width;
+    }
+    return top;
+}
+
+int TextureAtlas::newPage(SDL_Renderer* renderer)
+{
+    // pages no bigger than the renderer can take, 0 means there is no limit
+    SDL_RendererInfo info;
+    int width = PAGE_SIZE;
+    int height = PAGE_SIZE;
+    if (SDL_GetRendererInfo(renderer, &info) == 0)
+    {
+        if (info.max_texture_width > 0)
+        {
+            width = std::min(width, info.max_texture_width);
+        }
+        if (info.max_texture_height > 0)
+        {
+            height = std::min(height, info.max_texture_height);
+        }
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, width, height);
+    if (texture == nullptr)
+    {
+        std::cerr << "Unable to create texture atlas page! SDL Error: " << SDL_GetError() << std::endl;
+        return -1;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    Page page = { renderer, texture, width, height, { { 0, 0, width } }, 0 };
+
+    // reuse the slot of a destroyed page, the indices of the others are kept by their entries
+    for (size_t i = 0; i < mPages.size(); ++i)
+    {
+        if (mPages[i].texture == nullptr)
+        {
+            mPages[i] = page;
+            return int(i);
+        }
+    }
+    mPages.push_back(page);
+    return int(mPages.size() - 1);
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "../../dep/SDL2-2.30.5/include/SDL.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// Where an image was put in the atlas
+struct AtlasRegion
+{
+    SDL_Texture* page; // the texture to draw from
+    int pageWidth;
+    int pageHeight;
+    SDL_Rect rect; // the image inside page
+    int entry; // for TextureAtlas::release()
+    bool translucent; // some pixels are partly transparent, see partlyTransparent()
+};
+
+// Whether any pixel of surface has an alpha between 0 and 255. Fully transparent and fully
+// opaque pixels draw the same whether or not colour is premultiplied, the ones in between don't.
+bool partlyTransparent(SDL_Surface* surface);
+
+// Packs the images textures load into a few large textures (pages), so sprites with different
+// images can still be drawn from the same texture in one batch. Each image is added once under a key
+// (its path or resource), every later load of the same key shares it. Images are placed with a
+// skyline packer, each with a 1 pixel transparent border so filtering never picks up a neighbour.
+// A page is destroyed when the last image on it is released; the space of released images on a
+// page that is still in use is not reused.
+class TextureAtlas
+{
+public:
+    static const int PAGE_SIZE = 2048;
+
+    // Images bigger than this either way keep a texture of their own
+    static const int MAX_IMAGE_SIZE = PAGE_SIZE / 2;
+
+    // The image added under key for renderer, counted as one more user. False if there isn't one.
+    bool acquire(SDL_Renderer* renderer, const std::string& key, AtlasRegion& region);
+
+    // Copies surface into a page of renderer and keeps it under key, with one user.
+    // False if it is too big for the atlas or can't be uploaded.
+    bool add(SDL_Renderer* renderer, const std::string& key, SDL_Surface* surface, AtlasRegion& region);
+
+    // One user of region is done with it
+    void release(const AtlasRegion& region);
+
+    // Destroys renderer's pages, before the renderer itself goes. Regions on them can still be released.
+    void dropRenderer(SDL_Renderer* renderer);
+
+    size_t pageCount() const;
+
+private:
+    // One step of a page's skyline: from x, width wide, everything below y is taken
+    struct SkylineNode
+    {
+        int x;
+        int y;
+        int width;
+    };
+
+    struct Page
+    {
+        SDL_Renderer* renderer;
+        SDL_Texture* texture; // nullptr once the page is destroyed, the slot is then reused
+        int width;
+        int height;
+        std::vector<SkylineNode> skyline;
+        int images;
+    };
+
+    struct Entry
+    {
+        std::string key;
+        int page; // -1 once the page was dropped with its renderer
+        SDL_Rect rect;
+        bool translucent;
+        int users; // 0 for a free slot
+    };
+
+    // Finds room for a width x height box on page, false if it doesn't fit
+    static bool pack(Page& page, int width, int height, int& x, int& y);
+
+    // The y a width x height box at skyline node index would sit at, -1 if it doesn't fit there
+    static int fitAt(const Page& page, size_t index, int width, int height);
+
+    int newPage(SDL_Renderer* renderer);
+
+    std::vector<Page> mPages;
+    std::vector<Entry> mEntries;
+    std::vector<int> mFreeEntries;
+    std::unordered_map<std::string, int> mKeys; // key to entry, only entries on live pages
+};
\ No newline at end of file
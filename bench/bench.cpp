@@ -0,0 +1,208 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include <GameEngine.h>
+
+// Physics scaling benchmark: builds worlds of N players and M platforms with collisions on,
+// runs physics() headless for K ticks and prints one CSV line per world:
+// broadphase, players, platforms, ticks, ns per tick, player pairs tested per tick,
+// platform candidates per tick, allocations per tick ("n/a" unless the engine was built with the
+// Bench configuration, the only one that counts allocations).
+//
+// bench [--ticks K] [--broadphase brute|grid|bvh]
+// bench --selftest   runs the checks below instead and exits non-zero if any fail
+
+const int world_X = 192000;
+const int world_Y = 108000;
+
+const int player_sizes[] = { 1, 4, 16, 64, 256, 1024 };
+const int platform_sizes[] = { 10, 100, 1000, 10000, 100000 };
+
+void run(BroadphaseMode broadphase, const char* broadphase_name, int player_count, int platform_count, int ticks)
+{
+    init_headless(broadphase);
+
+    // Same seed every run so results compare between releases
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> random_x(0, world_X - 2000);
+    std::uniform_int_distribution<int> random_y(0, world_Y - 2000);
+    std::uniform_int_distribution<int> random_input(-160, 160);
+
+    reserve_entities(0, platform_count, player_count);
+
+    std::vector<StaticEntity*> platforms;
+    platforms.reserve(platform_count);
+    for (int i = 0; i < platform_count; ++i)
+    {
+        StaticEntity* platform = spawn<StaticEntity>(random_x(random), random_y(random), 2000, 300, 100, 100, 100, 255);
+        platform->CollisionsOn();
+        platforms.push_back(platform);
+    }
+
+    std::vector<Player*> players;
+    players.reserve(player_count);
+    for (int i = 0; i < player_count; ++i)
+    {
+        Player* player = spawn<Player>(random_x(random), random_y(random), 1000, 1500, 1000, 255, 0, 0, 255);
+        player->CollisionsOn();
+        players.push_back(player);
+    }
+
+    // Let the players settle onto the platforms first
+    step(10);
+
+    PhysicsStats stats_before = get_physics_stats();
+    unsigned long long allocations_before = allocation_count();
+    long long nanoseconds = 0;
+
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        // Change direction and jump now and then, so players keep crossing each other and platforms
+        if (tick % 30 == 0)
+        {
+            for (Player* player : players)
+            {
+                inject_input(player, random_input(random), tick % 60 == 0);
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        step(1);
+        nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    PhysicsStats stats = get_physics_stats();
+    unsigned long long allocations = allocation_count() - allocations_before;
+
+    std::cout << broadphase_name << ',' << player_count << ',' << platform_count << ',' << ticks << ','
+        << nanoseconds / ticks << ','
+        << double(stats.player_pairs_tested - stats_before.player_pairs_tested) / ticks << ','
+        << double(stats.platform_candidates - stats_before.platform_candidates) / ticks << ',';
+    if (allocation_counting())
+    {
+        std::cout << double(allocations) / ticks << std::endl;
+    }
+    else
+    {
+        std::cout << "n/a" << std::endl;
+    }
+
+    for (Player* player : players)
+    {
+        despawn(player);
+    }
+    for (StaticEntity* platform : platforms)
+    {
+        despawn(platform);
+    }
+}
+
+// Checks for engine code the DLL doesn't export, which the bench compiles in itself
+int failed_checks = 0;
+
+void check(bool passed, const char* what)
+{
+    if (!passed)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failed_checks;
+    }
+}
+
+void check_sweep()
+{
+    // a 10 * 10 box and a thin floor with its top at y = 100
+    PackedAABBs floor;
+    floor.push_back(0, 99, 100, 100);
+
+    SweepHit hit = sweepAABB(50, 1000, 50, -1000, 10, 10, floor);
+    check(hit.y == 100 && hit.normalY == 1, "sweep: falling far past a floor in one tick lands on it");
+
+    hit = sweepAABB(40, 110, 45, 90, 10, 10, floor);
+    check(hit.x == 45 && hit.y == 100 && hit.normalY == 1 && hit.normalX == 0, "sweep: landing keeps the horizontal move");
+
+    hit = sweepAABB(50, 100, 50, 100, 10, 10, floor);
+    check(hit.x == 50 && hit.y == 100 && hit.normalY == 0, "sweep: resting on a floor isn't an overlap");
+
+    PackedAABBs block;
+    block.push_back(0, 0, 1000, 100);
+    hit = sweepAABB(900, 200, 1200, -300, 50, 50, block);
+    check(hit.x == 1200 && hit.y == 100 && hit.normalY == 1 && hit.normalX == 0, "sweep: diagonal past a corner lands on top and slides");
+
+    hit = sweepAABB(1100, 200, 900, -300, 50, 50, block);
+    check(hit.x == 1000 && hit.y == -300 && hit.normalX == 1 && hit.normalY == 0, "sweep: diagonal into a side stops at the wall and keeps falling");
+
+    hit = sweepAABB(1100, 300, 900, 200, 50, 50, block);
+    check(hit.x == 900 && hit.y == 200 && hit.normalX == 0 && hit.normalY == 0, "sweep: a diagonal clear of a corner isn't stopped");
+
+    PackedAABBs ground;
+    ground.push_back(0, 0, 100, 100);
+    hit = sweepAABB(50, 95, 50, 85, 10, 10, ground);
+    check(hit.x == 50 && hit.y == 100 && hit.normalY == 1, "sweep: a box sunk into a floor is pushed out on top");
+
+    PackedAABBs wall;
+    wall.push_back(100, 0, 110, 1000);
+    hit = sweepAABB(92, 500, 95, 500, 10, 10, wall);
+    check(hit.x == 90 && hit.y == 500 && hit.normalX == -1 && hit.normalY == 0, "sweep: a box sunk into a wall's side is pushed out sideways");
+}
+
+int selftest()
+{
+    check_sweep();
+
+    std::cout << (failed_checks == 0 ? "All checks passed" : "Some checks failed") << std::endl;
+    return failed_checks == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "--selftest") == 0)
+    {
+        return selftest();
+    }
+
+    int ticks = 600;
+    BroadphaseMode broadphase = BROADPHASE_GRID;
+    const char* broadphase_name = "grid";
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--ticks") == 0)
+        {
+            ticks = std::stoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--broadphase") == 0)
+        {
+            broadphase_name = argv[i + 1];
+            if (std::strcmp(broadphase_name, "brute") == 0)
+            {
+                broadphase = BROADPHASE_BRUTE_FORCE;
+            }
+            else if (std::strcmp(broadphase_name, "bvh") == 0)
+            {
+                broadphase = BROADPHASE_BVH;
+            }
+            else
+            {
+                broadphase = BROADPHASE_GRID;
+                broadphase_name = "grid";
+            }
+        }
+    }
+
+    std::cout << "broadphase,players,platforms,ticks,ns_per_tick,player_pairs_per_tick,platform_candidates_per_tick,allocations_per_tick" << std::endl;
+
+    for (int platform_count : platform_sizes)
+    {
+        for (int player_count : player_sizes)
+        {
+            run(broadphase, broadphase_name, player_count, platform_count, ticks);
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <cstring>
+
+#include "LevelFormat.h"
+
+// Turns a text level into the binary .lvl files load_level() maps.
+// One platform per line, blank lines and lines starting with # are ignored:
+//
+// platform <x> <y> <width> <height> <r> <g> <b> <a> [texture <resourceID>] [nocollide]
+//
+// Positions are bottom-left in world units (0 to 192,000 by 0 to 108,000). Platforms have
+// collisions on unless nocollide is given; texture uses a resource from the mapbg DLLs.
+//
+// levelconv <level.txt> <level.lvl>
+// levelconv --chunks <level.txt> <directory>
+//
+// --chunks cuts the level into LEVEL_CHUNK_SIZE chunks for enable_world_streaming(), writing
+// one chunk_<x>_<y>.lvl file into directory for every chunk that has platforms in it.
+
+bool parse_platform(std::istringstream& line, StaticEntityDesc& desc)
+{
+    long long x, y;
+    unsigned int sizeX, sizeY;
+    int r, g, b, a;
+    if (!(line >> x >> y >> sizeX >> sizeY >> r >> g >> b >> a))
+    {
+        return false;
+    }
+
+    desc = StaticEntityDesc();
+    desc.x = x;
+    desc.y = y;
+    desc.sizeX = sizeX;
+    desc.sizeY = sizeY;
+    desc.colour[0] = uint8_t(r);
+    desc.colour[1] = uint8_t(g);
+    desc.colour[2] = uint8_t(b);
+    desc.colour[3] = uint8_t(a);
+    desc.flags = STATIC_ENTITY_COLLISIONS;
+
+    std::string option;
+    while (line >> option)
+    {
+        if (option == "texture")
+        {
+            if (!(line >> desc.resourceID))
+            {
+                return false;
+            }
+        }
+        else if (option == "nocollide")
+        {
+            desc.flags &= ~STATIC_ENTITY_COLLISIONS;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    bool chunks = argc == 4 && std::strcmp(argv[1], "--chunks") == 0;
+    if (argc != 3 && !chunks)
+    {
+        std::cerr << "usage: levelconv <level.txt> <level.lvl>" << std::endl;
+        std::cerr << "       levelconv --chunks <level.txt> <directory>" << std::endl;
+        return 1;
+    }
+
+    const char* input_path = argv[chunks ? 2 : 1];
+    const char* output_path = argv[chunks ? 3 : 2];
+
+    std::ifstream input(input_path);
+    if (!input)
+    {
+        std::cerr << "Failed to open " << input_path << std::endl;
+        return 1;
+    }
+
+    std::vector<StaticEntityDesc> platforms;
+    std::string text;
+    for (int line_number = 1; std::getline(input, text); ++line_number)
+    {
+        std::istringstream line(text);
+        std::string kind;
+        if (!(line >> kind) || kind[0] == '#')
+        {
+            continue;
+        }
+
+        StaticEntityDesc desc;
+        if (kind != "platform" || !parse_platform(line, desc))
+        {
+            std::cerr << input_path << ":" << line_number << ": can't read \"" << text << "\"" << std::endl;
+            return 1;
+        }
+        platforms.push_back(desc);
+    }
+
+    if (chunks)
+    {
+        std::map<std::pair<int32_t, int32_t>, std::vector<StaticEntityDesc>> chunked;
+        for (const StaticEntityDesc& desc : platforms)
+        {
+            chunked[{ chunkOf(desc.x), chunkOf(desc.y) }].push_back(desc);
+        }
+
+        for (const auto& chunk : chunked)
+        {
+            std::string path = std::string(output_path) + "/" + chunkFileName(chunk.first.first, chunk.first.second);
+            if (!writeLevelFile(path, chunk.second.data(), chunk.second.size()))
+            {
+                std::cerr << "Failed to write " << path << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << "Wrote " << platforms.size() << " platforms in " << chunked.size() << " chunks to " << output_path << std::endl;
+        return 0;
+    }
+
+    if (!writeLevelFile(output_path, platforms.data(), platforms.size()))
+    {
+        std::cerr << "Failed to write " << output_path << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << platforms.size() << " platforms to " << output_path << std::endl;
+    return 0;
+}
\ No newline at end of file